@@ -6,7 +6,6 @@ FINLINE void _UpdateValue(BoardState& board, Pos pos, BitBoard moves, bool isEnd
 	Value value = LookupGen::GetPieceSquareValue(pieceType, pos, TEAM, isEndgame);
 	value += PieceValue::MOBILITY_BONUS[pieceType] * moves.BitCount();
 	board.teamData[TEAM].totalValue += value;
-	board.pieceValues[pos] = value;
 }
 
 template <uint8_t TEAM>
@@ -16,6 +15,110 @@ FINLINE void _UpdateAttacksPinsValues(BoardState& board) {
 	auto& etd = board.teamData[!TEAM];
 	bool isEndgame = board.IsEndgame();
 
+	BitBoard combinedOccupy = td.occupy | etd.occupy;
+	BitBoard kingPosMask = etd.pieceSets[PT_KING];
+
+	td.attack = etd.pinnedPieces = 0;
+	td.totalValue = 0;
+
+	{ // Pawns
+		// All pawns attack the same way, so do them as a set instead of one at a time
+		constexpr uint64_t FILE_A = 0x0101010101010101ull, FILE_H = FILE_A << BD_MAXI;
+		BitBoard pawns = td.pieceSets[PT_PAWN];
+		if (TEAM == TEAM_WHITE) {
+			td.attack |= ((pawns & ~FILE_A) << (BD_SIZE - 1)) | ((pawns & ~FILE_H) << (BD_SIZE + 1));
+		} else {
+			td.attack |= ((pawns & ~FILE_A) >> (BD_SIZE + 1)) | ((pawns & ~FILE_H) >> (BD_SIZE - 1));
+		}
+
+		// NOTE: Pawns have no mobility bonus, so only their squares matter
+		SASSERT(PieceValue::MOBILITY_BONUS[PT_PAWN] == 0);
+		pawns.Iterate(
+			[&](uint64_t i) {
+				td.totalValue += LookupGen::GetPieceSquareValue(PT_PAWN, i, TEAM, isEndgame);
+			}
+		);
+	}
+
+	td.pieceSets[PT_KNIGHT].Iterate(
+		[&](uint64_t i) {
+			BitBoard moves = LookupGen::GetKnightMoves(i);
+			td.attack |= moves;
+			_UpdateValue<TEAM, PT_KNIGHT>(board, i, moves, isEndgame);
+		}
+	);
+
+	// NOTE: The enemy king doesn't block our sliders, so that squares behind it still count as attacked
+	BitBoard sliderOccupy = combinedOccupy & ~kingPosMask;
+
+	td.pieceSets[PT_ROOK].Iterate(
+		[&](uint64_t i) {
+			BitBoard moves, baseMoves;
+			LookupGen::GetRookMoves(i, sliderOccupy, baseMoves, moves);
+			td.attack |= moves;
+			_UpdateValue<TEAM, PT_ROOK>(board, i, moves, isEndgame);
+		}
+	);
+
+	td.pieceSets[PT_BISHOP].Iterate(
+		[&](uint64_t i) {
+			BitBoard moves, baseMoves;
+			LookupGen::GetBishopMoves(i, sliderOccupy, baseMoves, moves);
+			td.attack |= moves;
+			_UpdateValue<TEAM, PT_BISHOP>(board, i, moves, isEndgame);
+		}
+	);
+
+	td.pieceSets[PT_QUEEN].Iterate(
+		[&](uint64_t i) {
+			BitBoard moves, baseMoves;
+			LookupGen::GetQueenMoves(i, sliderOccupy, baseMoves, moves);
+			td.attack |= moves;
+			_UpdateValue<TEAM, PT_QUEEN>(board, i, moves, isEndgame);
+		}
+	);
+
+	{ // King
+		BitBoard moves = LookupGen::GetKingMoves(td.kingPos);
+		td.attack |= moves;
+		_UpdateValue<TEAM, PT_KING>(board, td.kingPos, moves, isEndgame);
+	}
+
+	// Checks and pins are found from the enemy king's square, rather than testing every piece against it
+	// Pawns and knights check the king if it could attack them back the same way
+	td.checkers =
+		(LookupGen::GetPawnAttacks(etd.kingPos, !TEAM) & td.pieceSets[PT_PAWN]) |
+		(LookupGen::GetKnightMoves(etd.kingPos) & td.pieceSets[PT_KNIGHT]);
+
+	// Sliders can only check or pin along a line through the king
+	BitBoard alignedSliders =
+		((td.pieceSets[PT_ROOK] | td.pieceSets[PT_QUEEN]) & LookupGen::GetRookBaseMoves(etd.kingPos)) |
+		((td.pieceSets[PT_BISHOP] | td.pieceSets[PT_QUEEN]) & LookupGen::GetBishopBaseMoves(etd.kingPos));
+
+	alignedSliders.Iterate(
+		[&](uint64_t i) {
+			BitBoard blockers = LookupGen::GetBetweenMask(i, etd.kingPos) & combinedOccupy;
+			if (!blockers) {
+				td.checkers.Set(i, true);
+			} else if (blockers.BitCount() == 1) {
+				etd.pinnedPieces |= blockers;
+			}
+		}
+	);
+
+	if (td.checkers)
+		td.firstCheckingPiecePos = INTRIN_CTZ(td.checkers);
+}
+
+#ifdef _DEBUG
+// Straightforward version of _UpdateAttacksPinsValues() that handles each piece on its own, used to check it
+template <uint8_t TEAM>
+void _UpdateAttacksPinsValues_Reference(BoardState& board) {
+
+	auto& td = board.teamData[TEAM];
+	auto& etd = board.teamData[!TEAM];
+	bool isEndgame = board.IsEndgame();
+
 	BitBoard combinedOccupy = td.occupy | etd.occupy;
 
 	// Clear attacks/pins/checking pieces
@@ -131,6 +234,7 @@ FINLINE void _UpdateAttacksPinsValues(BoardState& board) {
 		_UpdateValue<TEAM, PT_KING>(board, td.kingPos, moves, isEndgame);
 	}
 }
+#endif
 
 void BoardState::UpdateAttacksPinsValues(uint8_t team) {
 	if (team == TEAM_WHITE) {
@@ -138,11 +242,88 @@ void BoardState::UpdateAttacksPinsValues(uint8_t team) {
 	} else {
 		_UpdateAttacksPinsValues<TEAM_BLACK>(*this);
 	}
+	teamData[team].needsUpdate = false;
+
+#ifdef _DEBUG
+	BoardState reference = *this;
+	if (team == TEAM_WHITE) {
+		_UpdateAttacksPinsValues_Reference<TEAM_WHITE>(reference);
+	} else {
+		_UpdateAttacksPinsValues_Reference<TEAM_BLACK>(reference);
+	}
+
+	auto& td = teamData[team], &refTD = reference.teamData[team];
+	bool matches =
+		td.attack == refTD.attack && td.checkers == refTD.checkers && td.totalValue == refTD.totalValue &&
+		teamData[!team].pinnedPieces == reference.teamData[!team].pinnedPieces;
+
+	// NOTE: With multiple checkers, which one is first can differ (and doesn't matter)
+	if (td.checkers.BitCount() == 1)
+		matches &= td.firstCheckingPiecePos == refTD.firstCheckingPiecePos;
+
+	if (!matches)
+		ERR_CLOSE("Attacks/pins/values of " << TEAM_NAMES[team] << " don't match a full recompute on BoardState " << *this);
+#endif
+}
+
+FINLINE void _SaveUndo(const BoardState& board, MoveUndo& undoOut) {
+	for (int i = 0; i < TEAM_AMOUNT; i++) {
+		auto& td = board.teamData[i];
+		auto& undoTD = undoOut.teamData[i];
+		undoTD.attack = td.attack;
+		undoTD.pinnedPieces = td.pinnedPieces;
+		undoTD.checkers = td.checkers;
+		undoTD.totalValue = td.totalValue;
+		undoTD.firstCheckingPiecePos = td.firstCheckingPiecePos;
+		undoTD.canCastle_Q = td.canCastle_Q;
+		undoTD.canCastle_K = td.canCastle_K;
+		undoTD.needsUpdate = td.needsUpdate;
+	}
+
+	undoOut.hash = board.hash;
+	undoOut.halfMovesSincePawnOrCapture = board.halfMovesSincePawnOrCapture;
+	undoOut.enPassantToPos = board.enPassantToPos;
+	undoOut.enPassantPawnPos = board.enPassantPawnPos;
+	undoOut.capturedPiece = PT_AMOUNT;
+}
+
+FINLINE void _RestoreUndo(BoardState& board, const MoveUndo& undo) {
+	for (int i = 0; i < TEAM_AMOUNT; i++) {
+		auto& td = board.teamData[i];
+		auto& undoTD = undo.teamData[i];
+		td.attack = undoTD.attack;
+		td.pinnedPieces = undoTD.pinnedPieces;
+		td.checkers = undoTD.checkers;
+		td.totalValue = undoTD.totalValue;
+		td.firstCheckingPiecePos = undoTD.firstCheckingPiecePos;
+		td.canCastle_Q = undoTD.canCastle_Q;
+		td.canCastle_K = undoTD.canCastle_K;
+		td.needsUpdate = undoTD.needsUpdate;
+	}
+
+	board.hash = undo.hash;
+	board.halfMovesSincePawnOrCapture = undo.halfMovesSincePawnOrCapture;
+	board.enPassantToPos = undo.enPassantToPos;
+	board.enPassantPawnPos = undo.enPassantPawnPos;
+}
+
+void BoardState::ExecuteNullMove(MoveUndo& undoOut) {
+	_SaveUndo(*this, undoOut);
+	ExecuteNullMove();
+}
+
+void BoardState::UndoNullMove(const MoveUndo& undo) {
+	turnTeam = !turnTeam;
+	_RestoreUndo(*this, undo);
 }
 
 void BoardState::ExecuteNullMove() {
-	UpdateAttacksPinsValues(turnTeam);
-	enPassantToMask = 0;
+	teamData[turnTeam].needsUpdate = true;
+	enPassantToPos = 0;
+
+	// Positions before a null move can't be repeated by real moves, so treat it as irreversible
+	halfMovesSincePawnOrCapture = 0;
+
 	turnTeam = !turnTeam;
 #ifdef UPDATE_HASHES
 	hash ^= LookupGen::HashTurn();
@@ -150,6 +331,56 @@ void BoardState::ExecuteNullMove() {
 }
 
 void BoardState::ExecuteMove(Move move) {
+	_ExecuteMove<false>(move, NULL);
+}
+
+void BoardState::ExecuteMove(Move move, MoveUndo& undoOut) {
+	_ExecuteMove<true>(move, &undoOut);
+}
+
+void BoardState::UndoMove(Move move, const MoveUndo& undo) {
+	// Back to the team that made the move
+	turnTeam = !turnTeam;
+
+	auto& td = teamData[turnTeam];
+	auto& etd = teamData[!turnTeam];
+
+	BitBoard
+		fromMask = (1ull << move.from),
+		toMaskInv = ~(1ull << move.to);
+
+	// Move our piece back
+	td.pieceSets[move.resultPiece] &= toMaskInv;
+	td.pieceSets[move.originalPiece] |= fromMask;
+	td.occupy &= toMaskInv;
+	td.occupy |= fromMask;
+
+	if (move.originalPiece == PT_KING) {
+		td.kingPos = move.from;
+
+		int xDelta = move.to.X() - move.from.X();
+		if (xDelta && ((xDelta & 1) == 0)) {
+			// Move the castled rook back
+			Pos rookFromPos = Pos((xDelta > 0 ? BD_SIZE - 1 : 0), move.from.Y());
+			Pos rookToPos = move.from.index + xDelta / 2;
+			BitBoard rookFlipMask = (1ull << rookFromPos) | (1ull << rookToPos);
+
+			td.pieceSets[PT_ROOK] ^= rookFlipMask;
+			td.occupy ^= rookFlipMask;
+		}
+	}
+
+	// Put back whatever we captured
+	if (undo.capturedPiece != PT_AMOUNT) {
+		etd.pieceSets[undo.capturedPiece].Set(undo.capturedPos, true);
+		etd.occupy.Set(undo.capturedPos, true);
+	}
+
+	_RestoreUndo(*this, undo);
+}
+
+template <bool SAVE_UNDO>
+void BoardState::_ExecuteMove(Move move, MoveUndo* undoOut) {
 	auto& td = teamData[turnTeam];
 	auto& etd = teamData[!turnTeam];
 
@@ -158,6 +389,9 @@ void BoardState::ExecuteMove(Move move) {
 		toMask = (1ull << move.to),
 		toMaskInv = ~toMask;
 
+	if constexpr (SAVE_UNDO)
+		_SaveUndo(*this, *undoOut);
+
 #ifdef _DEBUG
 	bool isBad = false;
 	if (!td.occupy[move.from] || td.occupy[move.to]) {
@@ -177,30 +411,36 @@ void BoardState::ExecuteMove(Move move) {
 	hash ^= LookupGen::HashCastleRights(!turnTeam, etd.canCastle_Q, etd.canCastle_K);
 #endif
 
-	Pos newEnPassantPos = 0;
-	uint64_t newEnPassantMask = 0;
+	bool isEndgame = IsEndgame();
+
+	Pos newEnPassantPawnPos = 0, newEnPassantToPos = 0;
 
 	// En passant capture
 	if (move.originalPiece == PT_PAWN) {
-		if (toMask == enPassantToMask) {
+		if (move.to == enPassantToPos && enPassantToPos) {
 			// Remove piece behind our pawn
 			etd.occupy.Set(enPassantPawnPos, 0);
 			etd.pieceSets[PT_PAWN].Set(enPassantPawnPos, 0);
 
+			if constexpr (SAVE_UNDO) {
+				undoOut->capturedPiece = PT_PAWN;
+				undoOut->capturedPos = enPassantPawnPos;
+			}
+
 #ifdef UPDATE_HASHES
 			// Remove pawn hash
-			hash ^= LookupGen::HashPiece(PT_ROOK, enPassantPawnPos, !turnTeam);
+			hash ^= LookupGen::HashPiece(PT_PAWN, enPassantPawnPos, !turnTeam);
 #endif
 
 #ifdef UPDATE_VALUES
 			// Remove pawn value
-			etd.totalValue -= pieceValues[enPassantPawnPos];
+			etd.totalValue -= LookupGen::GetPieceSquareValue(PT_PAWN, enPassantPawnPos, !turnTeam, isEndgame);
 #endif
 
 		} else if (abs(move.to - move.from) > BD_SIZE + 1) {
 			// Double pawn move, set en passant mask behind us
-			newEnPassantMask = (turnTeam == TEAM_WHITE ? toMask >> BD_SIZE : toMask << BD_SIZE);
-			newEnPassantPos = move.to;
+			newEnPassantToPos = (move.from + move.to) / 2;
+			newEnPassantPawnPos = move.to;
 		}
 	} else if (move.originalPiece == PT_KING) {
 		{ // Update king pos
@@ -220,7 +460,6 @@ void BoardState::ExecuteMove(Move move) {
 			BitBoard rookFlipMask = (1ull << rookFromPos) | (1ull << rookToPos);
 
 			td.pieceSets[PT_ROOK] ^= rookFlipMask;
-			pieceTypes[rookToPos] = PT_ROOK;
 			td.occupy ^= rookFlipMask;
 
 #ifdef UPDATE_HASHES
@@ -231,16 +470,16 @@ void BoardState::ExecuteMove(Move move) {
 		}
 	}
 
-	if (newEnPassantMask != enPassantToMask) {
+	if (newEnPassantToPos != enPassantToPos) {
 
 #ifdef UPDATE_HASHES
 		// Update en passant hashes
-		hash ^= LookupGen::HashEnPassant(enPassantToMask != 0, enPassantPawnPos);
-		hash ^= LookupGen::HashEnPassant(newEnPassantMask != 0, newEnPassantPos);
+		hash ^= LookupGen::HashEnPassant(enPassantToPos != 0, enPassantPawnPos);
+		hash ^= LookupGen::HashEnPassant(newEnPassantToPos != 0, newEnPassantPawnPos);
 #endif
 
-		enPassantToMask = newEnPassantMask;
-		enPassantPawnPos = newEnPassantPos;
+		enPassantToPos = newEnPassantToPos;
+		enPassantPawnPos = newEnPassantPawnPos;
 	}
 
 	// Order: Queen-side, King-side
@@ -254,13 +493,6 @@ void BoardState::ExecuteMove(Move move) {
 		}
 	};
 
-#ifdef UPDATE_VALUES
-	{ // Remove enemy piece value on capture
-		if (etd.occupy[move.to])
-			etd.totalValue -= pieceValues[move.to];
-	}
-#endif
-
 	constexpr uint64_t
 		CASTLING_ALL_ROOK_LOCS = ANI_BM('A1') | ANI_BM('H1') | ANI_BM('A8') | ANI_BM('H8'),
 		CASTLING_ALL_ROOK_LOCS_INV = ~CASTLING_ALL_ROOK_LOCS;
@@ -302,19 +534,36 @@ void BoardState::ExecuteMove(Move move) {
 	hash ^= LookupGen::HashPiece(move.resultPiece, move.to, turnTeam);
 #endif
 
+	if (move.originalPiece == PT_PAWN || (etd.occupy & toMask)) {
+		// Irreversible move
+		halfMovesSincePawnOrCapture = 0;
+	} else if (halfMovesSincePawnOrCapture < UINT8_MAX) {
+		halfMovesSincePawnOrCapture++;
+	}
+
 	if (etd.occupy & toMask) {
-		uint8_t capturedPieceType = pieceTypes[move.to];
+		uint8_t capturedPieceType = GetPieceTypeAt(move.to, !turnTeam);
 		etd.pieceSets[capturedPieceType] &= toMaskInv;
+
+		if constexpr (SAVE_UNDO) {
+			undoOut->capturedPiece = capturedPieceType;
+			undoOut->capturedPos = move.to;
+		}
+
+#ifdef UPDATE_VALUES
+		// Remove enemy piece value
+		// NOTE: Only the piece-square part, its mobility bonus goes away when the enemy's values are next updated
+		etd.totalValue -= LookupGen::GetPieceSquareValue(capturedPieceType, move.to, !turnTeam, isEndgame);
+#endif
+
 #ifdef UPDATE_HASHES
 		hash ^= LookupGen::HashPiece(capturedPieceType, move.to, !turnTeam);
 #endif
 		etd.occupy &= toMaskInv;
 	}
 
-	// Update piece types
-	pieceTypes[move.to] = move.resultPiece;
-
-	UpdateAttacksPinsValues(turnTeam);
+	// Our attacks are only recomputed once they are needed
+	td.needsUpdate = true;
 
 #ifdef UPDATE_HASHES
 	hash ^= LookupGen::turnHashKey;
@@ -345,8 +594,6 @@ void BoardState::ForceUpdateAll() {
 			[&](uint64_t i) {
 				for (int j = 0; j < PT_AMOUNT; j++) {
 					if (td.pieceSets[j][i]) {
-						pieceTypes[i] = j;
-
 						hash ^= LookupGen::HashPiece(j, i, team);
 					}
 				}
@@ -361,7 +608,7 @@ void BoardState::ForceUpdateAll() {
 	}
 
 #ifdef UPDATE_HASHES
-	hash ^= LookupGen::HashEnPassant(enPassantToMask != 0, enPassantPawnPos);
+	hash ^= LookupGen::HashEnPassant(enPassantToPos != 0, enPassantPawnPos);
 	if (turnTeam == TEAM_BLACK)
 		hash ^= LookupGen::HashTurn();
 #endif
@@ -10,11 +10,38 @@
 #define UPDATE_VALUES
 #define UPDATE_HASHES
 
-// Stores all info for the state of a chess game
-struct BoardState {
+// Define to have search and perft make and unmake moves on a single board (see MoveUndo), instead of copying the board for every node
+// NOTE: Off by default, as BoardState is small enough that copy-make is currently faster
+//#define MAKE_UNMAKE
+
+// Everything that ExecuteMove() changes that can't be recovered from the move itself
+// NOTE: Includes the attack state of both teams, as evaluating a leaf also updates the side to move
+struct MoveUndo {
 	struct TeamData {
-		Pos kingPos; 
+		BitBoard attack, pinnedPieces, checkers;
+		int32_t totalValue;
+		Pos firstCheckingPiecePos;
+		bool canCastle_Q : 1, canCastle_K : 1, needsUpdate : 1;
+	};
+	TeamData teamData[TEAM_AMOUNT];
+
+	ZobristHash hash;
+	uint8_t halfMovesSincePawnOrCapture;
+	Pos enPassantToPos, enPassantPawnPos;
+
+	// The piece that was captured, PT_AMOUNT if nothing was captured
+	uint8_t capturedPiece;
 
+	// Where the captured piece was
+	// NOTE: Differs from the move's destination for en passant
+	Pos capturedPos;
+};
+
+// Stores all info for the state of a chess game
+// NOTE: Search copies this for every node, so keep it small
+//	Anything that can be derived cheaply (such as which piece is on a square) is looked up instead of stored
+struct alignas(64) BoardState {
+	struct TeamData {
 		// What squares we have pieces in
 		BitBoard occupy;
 
@@ -31,41 +58,62 @@ struct BoardState {
 		// Pieces that check the enemy king
 		BitBoard checkers;
 
+		// Value of all of our pieces
+		// NOTE: Narrower than Value, the total of one team's pieces is always small
+		int32_t totalValue;
+
+		Pos kingPos;
+
 		// If checkers != 0, the first piece to check the king is here
 		Pos firstCheckingPiecePos;
 
-		bool canCastle_Q; // Can castle queen-side (right/+x)
-		bool canCastle_K; // Can castle king-side (left/-x)
+		bool canCastle_Q : 1; // Can castle queen-side (right/+x)
+		bool canCastle_K : 1; // Can castle king-side (left/-x)
 
-		float totalValue; // Value of all of our pieces
+		// Set when we move, as our attacks, checkers, value (and the enemy's pinned pieces) are then out of date
+		// They are only recomputed once something uses them (see UpdateIfNeeded()), so nodes that are cut off never pay for it
+		// NOTE: Our data isn't updated when the enemy moves either, but nothing relies on it being exact then
+		bool needsUpdate : 1;
 	};
 	TeamData teamData[TEAM_AMOUNT];
-	
-	// Number of half-moves since a pawn advanced or a piece was captured
-	// When counter reaches HALF_MOVE_DRAW_COUNT, its a draw
-	uint8_t halfMovesSincePawnOrCapture;
+
+	// The Zobrist hash of this board state, updated incrementally as moves are made
+	ZobristHash hash;
 
 	// What move number we are on, starts at 1
 	uint16_t moveNum = 1;
 
+	// Number of half-moves since a pawn advanced or a piece was captured
+	// When counter reaches HALF_MOVE_DRAW_COUNT, its a draw
+	uint8_t halfMovesSincePawnOrCapture = 0;
+
 	// Team who's turn it is
 	uint8_t turnTeam = TEAM_WHITE;
 
-	// Normally blank, has a single bit on when en passant is possible
-	BitBoard enPassantToMask;
+	// Square a pawn can move to by capturing en passant, 0 if en passant isn't possible
+	// NOTE: 0 (A1) can never be an en passant square
+	Pos enPassantToPos = 0;
 
 	// Position of the pawn that can be captured by en passant
-	// NOTE: Only valid if enPassantToMask != 0
+	// NOTE: Only valid if enPassantToPos != 0
 	Pos enPassantPawnPos;
 
-	// Which type of piece is at which position
-	uint8_t pieceTypes[BD_SQUARE_AMOUNT];
+	// Normally blank, has a single bit on when en passant is possible
+	FINLINE BitBoard GetEnPassantToMask() const {
+		return (1ull << enPassantToPos) & ~1ull;
+	}
 
-	// The Zobrist hash of this board state, updated incrementally as moves are made
-	ZobristHash hash;
+	// Which type of piece a team has at a position
+	// NOTE: That team must have a piece there
+	FINLINE uint8_t GetPieceTypeAt(Pos pos, uint8_t team) const {
+		const TeamData& td = teamData[team];
+		ASSERT(td.occupy[pos]);
+		for (uint8_t i = 0; i < PT_AMOUNT - 1; i++)
+			if (td.pieceSets[i][pos])
+				return i;
 
-	// Values of each piece
-	Value pieceValues[BD_SQUARE_AMOUNT];
+		return PT_KING;
+	}
 
 	// Updates all persistent values, call this when you modify the board beyond ExecuteMove()
 	void ForceUpdateAll();
@@ -73,16 +121,37 @@ struct BoardState {
 	// Execute a move on the board, update accordingly
 	void ExecuteMove(Move move);
 
+	// Same as ExecuteMove(Move), but also records what is needed to undo the move with UndoMove()
+	void ExecuteMove(Move move, MoveUndo& undoOut);
+
+	// Restore the board to how it was before ExecuteMove(move, undo)
+	void UndoMove(Move move, const MoveUndo& undo);
+
 	// Update a team's attack and pin masks, within an update mask
 	void UpdateAttacksPinsValues(uint8_t team);
 
+	// Updates a team's attack and pin masks if it has moved since they were last updated
+	// NOTE: MoveGen needs the enemy of the team to move to be up to date, so call this for them first
+	FINLINE void UpdateIfNeeded(uint8_t team) {
+		if (teamData[team].needsUpdate)
+			UpdateAttacksPinsValues(team);
+	}
+
 	// Execute a move that does nothing and just switches whos turn it is
 	void ExecuteNullMove();
+	void ExecuteNullMove(MoveUndo& undoOut);
+	void UndoNullMove(const MoveUndo& undo);
 
 	FINLINE bool IsEndgame() {
 		// TODO: Improve
 		return !teamData[TEAM_WHITE].pieceSets[PT_QUEEN] && !teamData[TEAM_BLACK].pieceSets[PT_QUEEN];
 	}
 
+	// NOTE: Shared implementation of both ExecuteMove() overloads, use those instead
+	template <bool SAVE_UNDO>
+	void _ExecuteMove(Move move, MoveUndo* undoOut);
+
 	friend std::ostream& operator <<(std::ostream& stream, const BoardState& boardState);
-};
\ No newline at end of file
+};
+
+SASSERT(sizeof(BoardState) <= 192, "BoardState should stay small, it is copied for every node searched");
\ No newline at end of file
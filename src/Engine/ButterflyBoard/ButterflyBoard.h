@@ -2,16 +2,34 @@
 
 #include "../PieceValue/PieceValue.h"
 
-// Bitflags that can be OR'd together
-enum {
-	BUTTERFLY_VAL_BETA_CUTOFF = 128,
-	BUTTERFLY_VAL_ALPHA_BEST = 64,
-};
+// History entries are kept within [-BUTTERFLY_MAX_VAL, BUTTERFLY_MAX_VAL] by UpdateHistoryEntry()
+#define BUTTERFLY_MAX_VAL 8192
+
+// Applies a bonus (or penalty if negative) to a history entry
+// "History gravity": the closer an entry is to the limit, the less it moves in that direction
+// This keeps entries bounded without wipes, and lets recent results outweigh old ones
+FINLINE void UpdateHistoryEntry(int16_t& entry, int bonus) {
+	entry += bonus - (entry * abs(bonus) / BUTTERFLY_MAX_VAL);
+}
 
+// History heuristic table, indexed by [team][from][to]
+// Quiet moves that cause beta cutoffs gain score, quiet moves searched before them lose score
+// NOTE: Never wiped during a search, old results fade out through the update formula and Age()
 struct ButterflyBoard {
-	Value data[TEAM_AMOUNT][BD_SQUARE_AMOUNT][BD_SQUARE_AMOUNT] = {};
+	int16_t data[TEAM_AMOUNT][BD_SQUARE_AMOUNT][BD_SQUARE_AMOUNT] = {};
+
+	// Bonus for a cutoff at a given depth remaining
+	static FINLINE int GetBonus(uint16_t depthRemaining) {
+		return MIN((int)depthRemaining * depthRemaining * 16, BUTTERFLY_MAX_VAL / 4);
+	}
 
-	FINLINE void Reset() {
-		memset(data, 0, sizeof(data));
+	FINLINE void UpdateEntry(uint8_t team, Pos from, Pos to, int bonus) {
+		UpdateHistoryEntry(data[team][from][to], bonus);
 	}
-};
\ No newline at end of file
+
+	// Called between searches, so the previous search still guides move ordering without dominating it
+	FINLINE void Age() {
+		for (int16_t* entry = &data[0][0][0]; entry != &data[0][0][0] + sizeof(data) / sizeof(int16_t); entry++)
+			*entry /= 2;
+	}
+};
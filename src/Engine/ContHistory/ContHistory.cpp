@@ -0,0 +1,7 @@
+#include "ContHistory.h"
+
+void ContHistory::Age() {
+	int16_t* values = &data[0][0][0][0];
+	for (size_t i = 0; i < sizeof(data) / sizeof(int16_t); i++)
+		values[i] /= 2;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../ButterflyBoard/ButterflyBoard.h"
+#include "../Move/Move.h"
+
+// Continuation history, indexed by [earlier move's piece][earlier move's to][piece][to]
+// Scores how well a quiet move did when played some amount of plies after a given earlier move
+// NOTE: Squares are relative to the team making each move (flipped vertically for black),
+//	so both teams share one table at half the size
+struct ContHistory {
+	// History of every [piece][to] following one specific earlier move
+	typedef int16_t Entry[PT_AMOUNT][BD_SQUARE_AMOUNT];
+
+	Entry data[PT_AMOUNT][BD_SQUARE_AMOUNT] = {};
+
+	static FINLINE Pos RelativePos(Pos pos, uint8_t team) {
+		return (team == TEAM_WHITE) ? pos : Pos(pos.index ^ (BD_SQUARE_AMOUNT - BD_SIZE));
+	}
+
+	// Returns NULL if the earlier move is invalid (a null move, or no move at all)
+	FINLINE Entry* GetEntry(const Move& earlierMove, uint8_t earlierTeam) {
+		if (!earlierMove.IsValid())
+			return NULL;
+
+		return &data[earlierMove.resultPiece][RelativePos(earlierMove.to, earlierTeam)];
+	}
+
+	static FINLINE int16_t& GetValue(Entry& entry, uint8_t piece, Pos to, uint8_t team) {
+		return entry[piece][RelativePos(to, team)];
+	}
+
+	// Called between searches, see ButterflyBoard::Age()
+	void Age();
+};
@@ -1,28 +1,47 @@
 #include "Engine.h"
 
 #include "Transpos/Transpos.h"
+#include "PerftCache/PerftCache.h"
 #include "MoveGen/MoveGen.h"
 #include "MoveOrdering/MoveOrdering.h"
 #include "MoveRating/MoveRating.h"
+#include "MovePicker/MovePicker.h"
 #include "ButterflyBoard/ButterflyBoard.h"
+#include "ContHistory/ContHistory.h"
 #include "Heuristics/Heuristics.h"
-
-size_t g_FirstBestMoveIdx = MAX_MOVES;
+#include "SEE/SEE.h"
+#include "NNUE/NNUE.h"
 
 Move g_CurPV[MAX_SEARCH_DEPTH] = {};
 uint16_t g_CurPVLength = 0;
 
 uint8_t g_CurState = Engine::STATE_INITIALIZING;
 BoardState g_Position = BoardState();
+vector<ZobristHash> g_PositionHistory = {};
 Engine::Stats g_Stats = Engine::Stats();
 std::mutex infoMutex = std::mutex();
 
 // NOTE: infoMutex does not apply to this, as this variable needs to be checked very frequently
-bool g_StopSearch = false;
+// Atomic because every search thread polls it
+std::atomic<bool> g_StopSearch = false;
+
+// Set while searching the position we expect after the opponent's move ("go ponder")
+// Time limits don't apply until the opponent actually plays it ("ponderhit")
+std::atomic<bool> g_IsPondering = false;
 
 // NOTE: No mutex for this
 Engine::Settings g_Settings;
 
+// Only used by the main search thread, except for PonderHit()
+TimeManager g_TimeManager;
+
+// Nodes the main thread may search before stopping ("go nodes"), UINT64_MAX if unlimited
+// NOTE: Only the main thread's nodes count, so a single-threaded search stops at exactly the same point every time
+uint64_t g_NodeLimit = UINT64_MAX;
+
+// Evaluate leaves with NNUE instead of the hand-crafted eval, set at the start of every search
+bool g_UseNNUE = false;
+
 Engine::Settings& Engine::GetSettings() {
 	return g_Settings;
 }
@@ -67,11 +86,30 @@ Engine::Stats Engine::GetStats() {
 	return result;
 }
 
-void Engine::SetPosition(const BoardState& boardState) {
+void Engine::SetPosition(const BoardState& boardState, const vector<ZobristHash>& history) {
 	infoMutex.lock();
 	// NOTE: It's perfectly fine if we are in a search when this happens.
 	//	That search will continue with the previous state.
 	g_Position = boardState;
+	g_PositionHistory = history;
+
+	// Copies of the position are given straight to MoveGen, so it must be fully up to date
+	g_Position.UpdateIfNeeded(!g_Position.turnTeam);
+	infoMutex.unlock();
+}
+
+void Engine::PonderHit() {
+	infoMutex.lock();
+	if (g_CurState == STATE_SEARCHING && g_IsPondering) {
+		if (g_TimeManager.GetElapsedMS() >= g_TimeManager.baseSoftLimitMS) {
+			// We already pondered for longer than we would have searched this move normally
+			g_StopSearch = true;
+		} else {
+			// Our clock only started running now
+			g_TimeManager.Restart();
+		}
+		g_IsPondering = false;
+	}
 	infoMutex.unlock();
 }
 
@@ -83,9 +121,6 @@ void Engine::StopSearch() {
 	infoMutex.unlock();
 }
 
-static ButterflyBoard g_ButterflyBoard = {};
-constexpr uint16_t BUTTERFLY_BOARD_DEPTH = 7; // Depth at which we reset and start using the butterfly board
-
 template<uint8_t TEAM>
 FINLINE Value CalcRelativeEval(const BoardState& boardState, bool isEndgame) {
 	Value
@@ -100,19 +135,208 @@ FINLINE Value CalcRelativeEval(const BoardState& boardState, bool isEndgame) {
 
 struct SearchInfo {
 	uint16_t
-		curDepth = 0, depthRemaining, curExtendedDepth = 0, extendedDepthRemaining;
+		curDepth = 0, depthRemaining;
 
 	bool nullMoveUsed = false;
 };
 
 struct SearchFrame {
-	MoveList moves;
+	MoveList moves, badCaptures;
+
+	// Packed quiet moves that recently caused a beta cutoff at this ply, most recent first
+	uint16_t killers[KILLER_MOVE_AMOUNT];
+
+	// Packed quiet moves searched so far at this ply, they get a history penalty if a later quiet move cuts off
+	uint16_t quietsTried[MAX_MOVES];
+
+	// The last two moves played before this position, most recent first
+	// Invalid for null moves, or moves from before the search started
+	Move prevMoves[2];
+
+	// Best line found from this position, starting with this ply's best move
+	// Together, the frames form a triangular PV table: whenever a move raises alpha, its ply copies the child's line
+	Move pv[MAX_SEARCH_DEPTH];
+	uint16_t pvLength;
 };
 
+// Sets a frame's PV to a move followed by the PV of the frame below
+FINLINE void UpdatePV(SearchFrame* frame, const Move& move) {
+	const SearchFrame* child = frame + 1;
+	uint16_t childLength = MIN(child->pvLength, MAX_SEARCH_DEPTH - 1);
+
+	frame->pv[0] = move;
+	std::copy(child->pv, child->pv + childLength, frame->pv + 1);
+	frame->pvLength = childLength + 1;
+}
+
+// Everything a single search thread needs to itself
+// Threads only share the transposition table
+struct SearchThreadData {
+	// Thread 0 is the main thread, which reports info and the PV
+	uint8_t index;
+
+	ButterflyBoard butterflyBoard;
+
+	// Continuation history for moves 1 ply (index 0) and 2 plies (index 1) after an earlier move
+	ContHistory contHistories[2];
+
+	// Packed move that last caused a beta cutoff in response to [team][enemy piece][enemy move to], 0 if none
+	uint16_t counterMoves[TEAM_AMOUNT][PT_AMOUNT][BD_SQUARE_AMOUNT] = {};
+
+	Engine::Stats stats;
+
+	// Nodes left until we next check the clock (main thread only)
+	uint32_t nodesUntilLimitCheck;
+
+	// Packed root moves to skip, as they are already the best moves of earlier MultiPV lines
+	vector<uint16_t> rootExcludedMoves;
+
+	// Packed root moves we are restricted to ("go searchmoves"), empty if all moves are allowed
+	vector<uint16_t> rootSearchMoves;
+
+	SearchFrame frames[MAX_SEARCH_DEPTH + MAX_QSEARCH_DEPTH];
+
+	// NNUE accumulator of each frame's position
+	// NOTE: Kept apart from the frames, as NNUE needs its accumulators to be contiguous
+	NNUE::Accumulator accumulators[MAX_SEARCH_DEPTH + MAX_QSEARCH_DEPTH];
+
+	// Hashes of every position before the current one, from both the game history and the current search line
+	// Used for detecting repetitions
+	vector<ZobristHash> hashStack;
+};
+
+FINLINE NNUE::Accumulator& GetAccumulator(SearchThreadData& thread, SearchFrame* frame) {
+	return thread.accumulators[frame - thread.frames];
+}
+
+// Static eval of the position at a frame
 // NOTE: Value is relative to who's turn it is
+template<uint8_t TEAM>
+FINLINE Value EvaluateLeaf(SearchThreadData& thread, const BoardState& boardState, SearchFrame* frame, bool isEndgame) {
+	if (g_UseNNUE)
+		return NNUE::Evaluate(boardState, &GetAccumulator(thread, frame));
+
+	return CalcRelativeEval<TEAM>(boardState, isEndgame);
+}
+
+// Nodes between each check of the clock
+// Low enough that we stop within a few milliseconds of the deadline, high enough that the check costs nothing
+constexpr uint32_t SEARCH_LIMIT_CHECK_INTERVAL = 1024;
+
+// Returns true if a root move shouldn't be searched, either from MultiPV or "go searchmoves"
+FINLINE bool IsRootMoveExcluded(const SearchThreadData& thread, const Move& move) {
+	const vector<uint16_t>& excludedMoves = thread.rootExcludedMoves;
+	if (!excludedMoves.empty() && std::find(excludedMoves.begin(), excludedMoves.end(), move.Pack()) != excludedMoves.end())
+		return true;
+
+	const vector<uint16_t>& searchMoves = thread.rootSearchMoves;
+	return !searchMoves.empty() && std::find(searchMoves.begin(), searchMoves.end(), move.Pack()) == searchMoves.end();
+}
+
+// Stops the search once the node limit or the time manager's hard limit is reached
+// NOTE: Only the main thread checks, helpers are stopped along with it
+FINLINE void CheckSearchLimits(SearchThreadData& thread) {
+	if (thread.index != 0)
+		return;
+
+	// Checked every node, as node limits need to be exact
+	if (thread.stats.nodesSearched + thread.stats.qsearchNodes >= g_NodeLimit && !g_IsPondering) {
+		g_StopSearch = true;
+		return;
+	}
+
+	if (--thread.nodesUntilLimitCheck > 0)
+		return;
+
+	thread.nodesUntilLimitCheck = SEARCH_LIMIT_CHECK_INTERVAL;
+	if (!g_IsPondering && g_TimeManager.IsHardLimitReached())
+		g_StopSearch = true;
+}
+
+// Collects the history that applies to the position at a given frame
 template <uint8_t TEAM>
-Value MinMaxSearchRecursive(
-	BoardState& boardState, Value alpha, Value beta, SearchInfo& info, SearchFrame* frame
+FINLINE MoveRating::HistoryContext GetHistoryContext(SearchThreadData& thread, SearchFrame* frame) {
+	const Move& lastMove = frame->prevMoves[0];
+
+	MoveRating::HistoryContext history;
+	history.butterflyBoard = &thread.butterflyBoard;
+	history.contHistories[0] = thread.contHistories[0].GetEntry(lastMove, !TEAM);
+	history.contHistories[1] = thread.contHistories[1].GetEntry(frame->prevMoves[1], TEAM);
+	history.counterMove = lastMove.IsValid() ? thread.counterMoves[TEAM][lastMove.resultPiece][lastMove.to] : 0;
+	return history;
+}
+
+// NOTE: Allocated on the heap as each is pretty large, and only resized when the thread count changes
+vector<std::unique_ptr<SearchThreadData>> g_SearchThreads;
+
+// Stats of helper threads as of their last completed iteration, protected by infoMutex
+vector<Engine::Stats> g_HelperStats;
+
+// Returns true if this position has already occurred since the last irreversible move
+// NOTE: A single repetition is treated as a draw, as there's no point in searching the same position again
+FINLINE bool IsRepetition(const SearchThreadData& thread, const BoardState& boardState) {
+	size_t stackSize = thread.hashStack.size();
+	size_t maxPliesBack = MIN((size_t)boardState.halfMovesSincePawnOrCapture, stackSize);
+
+	// Positions 2 plies back can't be the same, and odd plies back have the other team to move
+	for (size_t pliesBack = 4; pliesBack <= maxPliesBack; pliesBack += 2)
+		if (thread.hashStack[stackSize - pliesBack] == boardState.hash)
+			return true;
+
+	return false;
+}
+
+// Returns true if a non-capturing move would put the enemy king in check, either directly or by uncovering one of our sliding pieces
+// NOTE: Ignores castling, and relies on the enemy's pinned pieces being up-to-date
+template <uint8_t TEAM>
+FINLINE bool IsQuietCheck(const BoardState& boardState, const Move& move) {
+	auto& td = boardState.teamData[TEAM];
+	auto& etd = boardState.teamData[!TEAM];
+
+	Pos enemyKingPos = etd.kingPos;
+
+	// Our pieces that are the only thing between one of our sliding pieces and the enemy king
+	if (etd.pinnedPieces[move.from] && !LookupGen::GetLineMask(move.from, enemyKingPos)[move.to])
+		return true;
+
+	BitBoard combinedOccupy = (td.occupy | etd.occupy) & ~(1ull << move.from);
+
+	BitBoard baseMoves, attacks;
+	switch (move.resultPiece) {
+	case PT_PAWN:
+		attacks = LookupGen::GetPawnAttacks(move.to, TEAM);
+		break;
+	case PT_KNIGHT:
+		attacks = LookupGen::GetKnightMoves(move.to);
+		break;
+	case PT_BISHOP:
+		LookupGen::GetBishopMoves(move.to, combinedOccupy, baseMoves, attacks);
+		break;
+	case PT_ROOK:
+		LookupGen::GetRookMoves(move.to, combinedOccupy, baseMoves, attacks);
+		break;
+	case PT_QUEEN:
+		LookupGen::GetQueenMoves(move.to, combinedOccupy, baseMoves, attacks);
+		break;
+	default:
+		return false;
+	}
+
+	return attacks[enemyKingPos];
+}
+
+// Value of being checkmated a given amount of plies from the root, relative to the team that is checkmated
+// Mates closer to the root are further from 0, so that we prefer the fastest checkmate (and the slowest loss)
+// NOTE: Always at least CHECKMATE_VALUE away from 0
+FINLINE Value GetCheckmatedValue(uint16_t ply) {
+	return -(CHECKMATE_VALUE + (MAX_SEARCH_DEPTH + MAX_QSEARCH_DEPTH - ply));
+}
+
+// Searches captures and promotions until the position is quiet, so that we never statically evaluate in the middle of an exchange
+// NOTE: Value is relative to who's turn it is
+template <uint8_t TEAM>
+Value QuiescenceSearch(
+	SearchThreadData& thread, BoardState& boardState, Value alpha, Value beta, uint16_t ply, uint16_t qsearchDepth, SearchFrame* frame
 ) {
 
 	if (g_StopSearch)
@@ -120,223 +344,564 @@ Value MinMaxSearchRecursive(
 
 	ASSERT(boardState.turnTeam == TEAM);
 
+	thread.stats.qsearchNodes++;
+	CheckSearchLimits(thread);
+
+	// Any table entry was searched at least as deep as we will here
 	TransposEntry* entry = Transpos::main.Find(boardState.hash);
-	bool entryHashMatches = (entry->fullHash == boardState.hash);
-	if (entryHashMatches) {
-		g_Stats.transposHits++;
 
-		if (entry->within) {
-			return 0; // Draw by repetition
+	// Our results are only stored at depth 0, so they must not replace an entry from the main search
+	bool canStoreEntry = true;
+	{
+		TransposData entryData;
+		if (entry->Load(boardState.hash, entryData)) {
+			thread.stats.transposHits++;
+			canStoreEntry = (entryData.depth == 0);
+
+			Value eval = Transpos::ValueFromEntry(entryData.eval, ply);
+			bool canUseEntry =
+				(entryData.bound == TRANSPOS_BOUND_EXACT) ||
+				(entryData.bound == TRANSPOS_BOUND_LOWER && eval >= beta) ||
+				(entryData.bound == TRANSPOS_BOUND_UPPER && eval <= alpha);
+
+			if (canUseEntry) {
+				thread.stats.transposOverrides++;
+				return CLAMP(eval, alpha, beta);
+			}
+		}
+	}
+
+	// Not cut off, so we now need the enemy's attacks from their last move
+	boardState.UpdateIfNeeded(!TEAM);
+
+	bool inCheck = boardState.teamData[!TEAM].checkers;
+	bool isEndgame = boardState.IsEndgame();
+
+	// Update values for this team
+	boardState.UpdateAttacksPinsValues(TEAM);
+
+	Value standPatEval = 0;
+	if (!inCheck) {
+		// Stand pat: we assume we could always make a quiet move that is at least as good as doing nothing
+		thread.stats.leafNodesEvaluated++;
+		standPatEval = EvaluateLeaf<TEAM>(thread, boardState, frame, isEndgame);
+
+		if (standPatEval >= beta || qsearchDepth >= MAX_QSEARCH_DEPTH - 1)
+			return standPatEval;
+
+		alpha = MAX(alpha, standPatEval);
+	} else if (qsearchDepth >= MAX_QSEARCH_DEPTH - 1) {
+		thread.stats.leafNodesEvaluated++;
+		return EvaluateLeaf<TEAM>(thread, boardState, frame, isEndgame);
+	}
+
+	MoveList& moves = frame->moves;
+	moves.Clear();
+	if (inCheck || (qsearchDepth == 0 && g_Settings.quiescenceChecks)) {
+		// Every evasion has to be considered when in check, and we also want quiet checks at the first ply
+		MoveGen::GetMoves(boardState, moves);
+
+		if (moves.size == 0) {
+			if (inCheck) {
+				// Checkmate!
+				thread.stats.matesFound++;
+				return GetCheckmatedValue(ply);
+			} else {
+				// Stalemate
+				thread.stats.stalematesFound++;
+				return 0;
+			}
+		}
+
+		if (!inCheck) {
+			// Filter down to captures, promotions, and checks
+			size_t filteredCount = 0;
+			for (Move& move : moves)
+				if (boardState.teamData[!TEAM].occupy[move.to] || move.originalPiece != move.resultPiece || IsQuietCheck<TEAM>(boardState, move))
+					moves.data[filteredCount++] = move;
+			moves.size = filteredCount;
+		}
+	} else {
+		MoveGen::GetNoisyMoves(boardState, moves);
+	}
+
+	MoveRating::RateCaptures(boardState, moves);
+
+	Value originalAlpha = alpha;
+	uint16_t bestMove = 0;
+
+	for (size_t i = 0; i < moves.size; i++) {
+		Move& move = MoveOrdering::PickNext(moves, i);
+
+		if (!inCheck) {
+			// Delta pruning
+			// Even winning the captured piece for free can't bring us back up to alpha, so don't bother
+			if (move.originalPiece == move.resultPiece && boardState.teamData[!TEAM].occupy[move.to]) {
+				constexpr Value DELTA_MARGIN = 200;
+				Value capturedValue = LookupGen::GetPieceSquareValue(boardState.GetPieceTypeAt(move.to, !TEAM), move.to, !TEAM, isEndgame);
+				if (standPatEval + capturedValue + DELTA_MARGIN < alpha)
+					continue;
+			}
+
+			// Skip moves that lose material, standing pat is already better
+			if (!SEE::IsAtLeast(boardState, move, 0))
+				continue;
+		}
+
+		if (g_UseNNUE)
+			NNUE::OnMove(boardState, move, GetAccumulator(thread, frame + 1));
+
+#ifdef MAKE_UNMAKE
+		MoveUndo undo;
+		boardState.ExecuteMove(move, undo);
+		BoardState& childBoardState = boardState;
+#else
+		BoardState childBoardState = boardState;
+		childBoardState.ExecuteMove(move);
+#endif
+
+		Value eval = -QuiescenceSearch<!TEAM>(thread, childBoardState, -beta, -alpha, ply + 1, qsearchDepth + 1, frame + 1);
+
+#ifdef MAKE_UNMAKE
+		boardState.UndoMove(move, undo);
+#endif
+
+		if (g_StopSearch)
+			return alpha; // Interrupted, eval is meaningless
+
+		if (eval >= beta) {
+			TransposData newEntryData = {};
+			newEntryData.eval = Transpos::ValueToEntry(beta, ply);
+			newEntryData.bestMove = move.Pack();
+			newEntryData.bound = TRANSPOS_BOUND_LOWER;
+			newEntryData.generation = Transpos::main.generation;
+			if (canStoreEntry)
+				entry->Store(boardState.hash, newEntryData);
+			return beta;
+		}
+
+		if (eval > alpha) {
+			alpha = eval;
+			bestMove = move.Pack();
 		}
 	}
 
-	if (entryHashMatches && entry->depth >= info.depthRemaining) {
-		// We've already evaluated this move at >= the current search depth, just use that
-		g_Stats.transposOverrides++;
+	// NOTE: Stored at depth 0, so only quiescence search will ever use the eval
+	TransposData newEntryData = {};
+	newEntryData.eval = Transpos::ValueToEntry(alpha, ply);
+	newEntryData.bestMove = bestMove;
+	newEntryData.bound = (alpha > originalAlpha) ? TRANSPOS_BOUND_EXACT : TRANSPOS_BOUND_UPPER;
+	newEntryData.generation = Transpos::main.generation;
+	if (canStoreEntry)
+		entry->Store(boardState.hash, newEntryData);
+
+	return alpha;
+}
+
+// NOTE: Value is relative to who's turn it is
+template <uint8_t TEAM>
+Value MinMaxSearchRecursive(
+	SearchThreadData& thread, BoardState& boardState, Value alpha, Value beta, SearchInfo& info, SearchFrame* frame
+) {
+
+	// Any return before a move raises alpha leaves no PV
+	frame->pvLength = 0;
+
+	if (g_StopSearch)
+		return alpha;
+
+	ASSERT(boardState.turnTeam == TEAM);
+
+	if (info.curDepth > 0 && IsRepetition(thread, boardState))
+		return 0; // Draw by repetition
+
+	if (info.depthRemaining == 0)
+		return QuiescenceSearch<TEAM>(thread, boardState, alpha, beta, info.curDepth, 0, frame);
+
+	thread.stats.nodesSearched++;
+	CheckSearchLimits(thread);
+
+	TransposEntry* entry = Transpos::main.Find(boardState.hash);
+	TransposData entryData;
+	bool entryHashMatches = entry->Load(boardState.hash, entryData);
+	if (entryHashMatches)
+		thread.stats.transposHits++;
+
+	// NOTE: Never cut off at the root, aspiration windows mean the entry may only be a bound with no best move
+	// Also never cut off in PV nodes (full window), as that would leave the PV cut short there
+	if (entryHashMatches && entryData.depth >= info.depthRemaining && info.curDepth > 0 && (beta - alpha == 1)) {
+		// We've already evaluated this position at >= the current search depth
+		// See if that result is enough to decide this node without searching
+		Value eval = Transpos::ValueFromEntry(entryData.eval, info.curDepth);
+		bool canUseEntry =
+			(entryData.bound == TRANSPOS_BOUND_EXACT) ||
+			(entryData.bound == TRANSPOS_BOUND_LOWER && eval >= beta) ||
+			(entryData.bound == TRANSPOS_BOUND_UPPER && eval <= alpha);
+
+		if (canUseEntry) {
+			thread.stats.transposOverrides++;
+			return CLAMP(eval, alpha, beta);
+		}
+	}
+
+	// Not cut off, so we now need the enemy's attacks from their last move
+	boardState.UpdateIfNeeded(!TEAM);
+
+	// We are now a parent of every position searched below (including the null move's)
+	thread.hashStack.push_back(boardState.hash);
+
+	// NOTE: Moves will be iterated backwards
+#ifdef ENABLE_NULL_MOVE_SEARCH
+	// Null move search/pruning
+	// TODO: Avoid running in zugzwang
+	if (info.depthRemaining > 3 && !boardState.IsEndgame() && !info.nullMoveUsed && !boardState.teamData[!TEAM].checkers) {
+		if (g_UseNNUE)
+			NNUE::OnNullMove(GetAccumulator(thread, frame + 1));
+
+#ifdef MAKE_UNMAKE
+		MoveUndo undo;
+		boardState.ExecuteNullMove(undo);
+		BoardState& childBoardState = boardState;
+#else
+		BoardState childBoardState = boardState;
+		childBoardState.ExecuteNullMove();
+#endif
+
+		(frame + 1)->prevMoves[0] = Move();
+		(frame + 1)->prevMoves[1] = frame->prevMoves[0];
+
+		info.curDepth++;
+		info.depthRemaining--;
+		Value eval = -MinMaxSearchRecursive<!TEAM>(thread, childBoardState, -beta, -alpha, info, frame + 1);
+		info.curDepth--;
+		info.depthRemaining++;
+
+#ifdef MAKE_UNMAKE
+		boardState.UndoNullMove(undo);
+#endif
+
+		if (g_StopSearch) {
+			thread.hashStack.pop_back();
+			return alpha;
+		}
 
-		Value eval = entry->eval;
 		if (eval >= beta) {
 			// Fail high
+			thread.hashStack.pop_back();
 			return beta;
 		}
 
-		alpha = MAX(alpha, eval);
+		info.nullMoveUsed = true;
+	}
+#endif
+
+	MoveRating::HistoryContext history = GetHistoryContext<TEAM>(thread, frame);
+	MovePicker picker = MovePicker(
+		boardState, frame->moves, frame->badCaptures, history,
+		entryHashMatches ? entryData.bestMove : 0, frame->killers
+	);
+
+	Value eval = boardState.teamData[TEAM].totalValue - boardState.teamData[!TEAM].totalValue;
+
+	// A root that skipped some moves didn't really search this position, so its result can't be stored
+	bool canStoreEntry = (info.curDepth > 0) || (thread.rootExcludedMoves.empty() && thread.rootSearchMoves.empty());
+
+	// If we never raise alpha, we only know that the true eval is <= alpha
+	Value originalAlpha = alpha;
+
+	uint16_t bestMove = 0;
+	size_t legalMoveCount = 0, quietsTriedCount = 0;
+	Move move;
+	while (picker.Next(move)) {
+		if (info.curDepth == 0 && IsRootMoveExcluded(thread, move))
+			continue;
 
-		if (info.curDepth == 0) {
-			g_FirstBestMoveIdx = entry->bestMoveTrueIndex;
+		legalMoveCount++;
+
+		uint16_t depthReduction = 1;
+
+		// Late move reduction
+		if (picker.IsLateMove() && info.curDepth > 3 && info.depthRemaining < 4) {
+			depthReduction++;
 		}
 
-	} else {
-		// No transposition entry for this position is as deep
+		bool isQuiet = !(move.flags & (Move::FL_CAPTURE | Move::FL_PROMOTION));
 
-		if (info.depthRemaining == 0) {
+		// Futility pruning
+		// Only applies to quiet moves and captures that lose material, the TT move and killers are always searched
+		if (info.depthRemaining == 1 && (picker.stage == PICK_STAGE_QUIETS || picker.stage == PICK_STAGE_BAD_CAPTURES)) {
+			constexpr Value FUTILITY_MARGIN = 100;
 
-			// Update values for this team
-			boardState.UpdateAttacksPinsValues(TEAM);
+			// Material the move should win (bad captures are rated by their SEE value), quiet moves aren't expected to win any
+			Value expectedGain = (picker.stage == PICK_STAGE_BAD_CAPTURES) ? move.moveRating : 0;
+			if (eval + expectedGain < alpha - FUTILITY_MARGIN) {
 
-			g_Stats.leafNodesEvaluated++;
-			return CalcRelativeEval<TEAM>(boardState, boardState.IsEndgame());
+				// Cannot possibly improve alpha
+				continue;
+			}
+		}
 
-			// NOTE: We won't bother setting a transposition entry for a zero-depth evaluation
-		} else {
+		if (g_UseNNUE)
+			NNUE::OnMove(boardState, move, GetAccumulator(thread, frame + 1));
+
+#ifdef MAKE_UNMAKE
+		MoveUndo undo;
+		boardState.ExecuteMove(move, undo);
+		BoardState& childBoardState = boardState;
+#else
+		BoardState childBoardState = boardState;
+		childBoardState.ExecuteMove(move);
+#endif
 
-			if (info.depthRemaining == BUTTERFLY_BOARD_DEPTH + 1) {
-				g_ButterflyBoard.Reset();
+		if (isQuiet)
+			frame->quietsTried[quietsTriedCount++] = move.Pack();
+
+		(frame + 1)->prevMoves[0] = move;
+		(frame + 1)->prevMoves[1] = frame->prevMoves[0];
+
+		// Don't reduce to negative depth
+		depthReduction = MIN(depthReduction, info.depthRemaining);
+
+		// Principal variation search
+		// Only the first move is searched with the full window, as with good move ordering it is usually the best
+		// Every other move just has to be proven worse with a cheap null window, and is only re-searched if it isn't
+		Value eval;
+		info.curDepth++;
+		if (legalMoveCount == 1) {
+			info.depthRemaining--;
+			eval = -MinMaxSearchRecursive<!TEAM>(thread, childBoardState, -beta, -alpha, info, frame + 1);
+			info.depthRemaining++;
+		} else {
+			info.depthRemaining -= depthReduction;
+			eval = -MinMaxSearchRecursive<!TEAM>(thread, childBoardState, -alpha - 1, -alpha, info, frame + 1);
+			info.depthRemaining += depthReduction;
+
+			// A reduced move that beat alpha has to be verified at full depth first
+			if (eval > alpha && depthReduction > 1 && !g_StopSearch) {
+				info.depthRemaining--;
+				eval = -MinMaxSearchRecursive<!TEAM>(thread, childBoardState, -alpha - 1, -alpha, info, frame + 1);
+				info.depthRemaining++;
 			}
 
-			// NOTE: Moves will be iterated backwards
-			MoveList& moves = frame->moves;
-			moves.Clear();
-			MoveGen::GetMoves(boardState, moves);
-			
-			size_t moveCount = moves.size;
-
-			if (moveCount == 0) {
-				if (boardState.teamData[!TEAM].checkers != 0) {
-					// Checkmate!
-					// Other team wins
-					g_Stats.matesFound++;
-					return -(CHECKMATE_VALUE + info.depthRemaining + info.extendedDepthRemaining); // Prioritize earlier checkmate
-				} else {
-					// Stalemate
-					g_Stats.stalematesFound++;
-					return 0;
-				}
-			} else {
-				size_t lastBestMoveIndex;
-				if (entryHashMatches) {
-					lastBestMoveIndex = entry->bestMoveTrueIndex;
-
-					if (lastBestMoveIndex < moveCount) {
-						// Explore the best move first
-						// We haven't ordered moves yet so this just requires index lookup
-						moves.Add(moves[lastBestMoveIndex]);
-						moveCount++;
-					} else {
-						// Hash collision!
-						// This entry no longer matches
-						g_Stats.transposBadMoveIndices++;
-						lastBestMoveIndex = -1;
-						entryHashMatches = false;
-					}
-				} else {
-					lastBestMoveIndex = -1;
-				}
-#ifdef ENABLE_NULL_MOVE_SEARCH
-				// Null move search/pruning
-				// TODO: Avoid running in zugzwang
-				if (info.depthRemaining > 3 && !boardState.IsEndgame() && !info.nullMoveUsed && !boardState.teamData[!TEAM].checkers) {
-					BoardState boardCopy = boardState;
+			// Re-search with the full window if it beat alpha
+			// (No need if the window was already null, as beating alpha means failing high)
+			if (eval > alpha && eval < beta && !g_StopSearch) {
+				thread.stats.pvsReSearches++;
+				info.depthRemaining--;
+				eval = -MinMaxSearchRecursive<!TEAM>(thread, childBoardState, -beta, -alpha, info, frame + 1);
+				info.depthRemaining++;
+			}
+		}
+		info.curDepth--;
 
-					boardCopy.ExecuteNullMove();
+#ifdef MAKE_UNMAKE
+		boardState.UndoMove(move, undo);
+#endif
 
-					info.curDepth++;
-					info.depthRemaining--;
-					Value eval = -MinMaxSearchRecursive<!TEAM>(boardCopy, -beta, -alpha, info, frame + 1);
-					info.curDepth--;
-					info.depthRemaining++;
+		if (g_StopSearch) {
+			// Interrupted, so eval is meaningless and must not reach the PV or transposition table
+			thread.hashStack.pop_back();
+			return alpha;
+		}
 
-					if (eval >= beta) {
-						// Fail high
-						return beta;
-					}
+		if (eval >= beta) {
+			// Fail high
+			// The true eval is at least beta, store that as a lower bound
+			TransposData newEntryData = {};
+			newEntryData.eval = Transpos::ValueToEntry(beta, info.curDepth);
+			newEntryData.bestMove = move.Pack();
+			newEntryData.depth = MIN(info.depthRemaining, UINT8_MAX);
+			newEntryData.bound = TRANSPOS_BOUND_LOWER;
+			newEntryData.generation = Transpos::main.generation;
+			if (canStoreEntry)
+				entry->Store(boardState.hash, newEntryData);
+
+			thread.hashStack.pop_back();
+
+			if (info.curDepth == 0) {
+				// Failed high at the root (aspiration window), this move is at least the best so far
+				UpdatePV(frame, move);
+			}
 
-					info.nullMoveUsed = true;
+			if (isQuiet) {
+				// Remember this move, it will probably cause cutoffs for sibling positions too
+				uint16_t packedMove = move.Pack();
+				if (frame->killers[0] != packedMove) {
+					frame->killers[1] = frame->killers[0];
+					frame->killers[0] = packedMove;
 				}
-#endif
 
-				MoveRating::RateMoves(boardState, moves, g_ButterflyBoard);
-				MoveOrdering::SortMoves(moves);
-
-				size_t quarterMoveCount = moveCount / 4;
-
-				Value eval = boardState.teamData[TEAM].totalValue - boardState.teamData[!TEAM].totalValue;
-
-				size_t bestMoveIndex = 0;
-				// NOTE: size_t is unsigned so our loop condition should be (i < size)
-				for (size_t i = moveCount - 1; i < moveCount; i--) {
-					if (lastBestMoveIndex == i) {
-						// We already added this move to the end of the vector
-						// Ignore its original location
-						continue;
-					}
-
-					uint16_t depthReduction = 1;
-
-					// Late move reduction
-					if (i < quarterMoveCount && info.curDepth > 3 && info.depthRemaining < 4) {
-						depthReduction++;
-					}
-
-					Move& move = moves[i];
-
-					bool isCapture = (move.flags & Move::FL_CAPTURE);
-					
-					// Futility pruning
-					if (info.depthRemaining == 1 && !isCapture) {
-						constexpr Value FUTILITY_MARGIN = 100;
-						if (eval + move.moveRating < alpha - FUTILITY_MARGIN) {
-
-							// Cannot possibly improve alpha
-							continue;
-						}
-					}
-
-					BoardState boardCopy = boardState;
-					boardCopy.ExecuteMove(move);
-
-					bool isCheck = boardCopy.teamData[TEAM].checkers;
-					entry->within = true;
-
-					Value eval;
-					if (
-						info.depthRemaining == 1 && // Final depth (not counting eval)
-						(isCapture || isCheck) &&
-						info.extendedDepthRemaining > 0 // We have extended depth left
-						) {
-						// Extended depth search
-						info.curExtendedDepth++;
-						info.extendedDepthRemaining--;
-						eval = -MinMaxSearchRecursive<!TEAM>(
-							boardCopy, -beta, -alpha, info, frame + 1
-						);
-						info.curExtendedDepth--;
-						info.extendedDepthRemaining++;
-					} else {
-						// Normal search
-
-						// Don't reduce to negative depth
-						depthReduction = MIN(depthReduction, info.depthRemaining);
-
-						info.curDepth++;
-						info.depthRemaining -= depthReduction;
-						eval = -MinMaxSearchRecursive<!TEAM>(
-							boardCopy, -beta, -alpha, info, frame + 1
-							);
-						info.curDepth--;
-						info.depthRemaining += depthReduction;
-					}
-
-					entry->within = false;
-
-					if (eval >= beta) {
-						// Fail high
-
-						if (info.depthRemaining <= BUTTERFLY_BOARD_DEPTH)
-							g_ButterflyBoard.data[TEAM][move.from][move.to] |= BUTTERFLY_VAL_BETA_CUTOFF;
-
-						return beta;
-					}
-
-					if (eval > alpha) {
-						// New best
-						if (info.depthRemaining <= BUTTERFLY_BOARD_DEPTH)
-							g_ButterflyBoard.data[TEAM][move.from][move.to] |= BUTTERFLY_VAL_ALPHA_BEST;
-
-						bestMoveIndex = move.trueIndex;
-						alpha = eval;
-
-						if (info.curDepth == 0) {
-							// Make sure first PV move is the best move
-							// This prevents a best move from failing to be selected if there is a TT collision
-							g_FirstBestMoveIdx = bestMoveIndex;
-						}
-					}
+				// Reward the cutoff move, and punish the quiet moves we wasted time on before it
+				int historyBonus = ButterflyBoard::GetBonus(info.depthRemaining);
+				for (size_t i = 0; i < quietsTriedCount; i++) {
+					uint16_t triedMove = frame->quietsTried[i];
+					Pos
+						from = triedMove & (BD_SQUARE_AMOUNT - 1),
+						to = (triedMove >> 6) & (BD_SQUARE_AMOUNT - 1);
+					uint8_t piece = triedMove >> 12; // Quiet moves don't promote, so this is also the moving piece
+					int bonus = (triedMove == packedMove) ? historyBonus : -historyBonus;
+
+					thread.butterflyBoard.UpdateEntry(TEAM, from, to, bonus);
+					for (ContHistory::Entry* contHistory : history.contHistories)
+						if (contHistory)
+							UpdateHistoryEntry(ContHistory::GetValue(*contHistory, piece, to, TEAM), bonus);
 				}
 
-				// Update table entry
-				entry->bestMoveTrueIndex = bestMoveIndex;
-				entry->fullHash = boardState.hash;
-				entry->depth = info.depthRemaining;
-				entry->eval = alpha;
+				const Move& lastMove = frame->prevMoves[0];
+				if (lastMove.IsValid())
+					thread.counterMoves[TEAM][lastMove.resultPiece][lastMove.to] = packedMove;
 			}
+
+			return beta;
+		}
+
+		if (eval > alpha) {
+			// New best
+			bestMove = move.Pack();
+			alpha = eval;
+
+			UpdatePV(frame, move);
+		}
+	}
+
+	thread.hashStack.pop_back();
+
+	if (picker.ttMoveInvalid) {
+		// Hash collision!
+		// The entry's best move isn't legal here
+		thread.stats.transposBadMoves++;
+	}
+
+	if (legalMoveCount == 0) {
+		if (boardState.teamData[!TEAM].checkers != 0) {
+			// Checkmate!
+			// Other team wins
+			thread.stats.matesFound++;
+			return GetCheckmatedValue(info.curDepth);
+		} else {
+			// Stalemate
+			thread.stats.stalematesFound++;
+			return 0;
 		}
 	}
 
+	// Update table entry
+	TransposData newEntryData = {};
+	newEntryData.eval = Transpos::ValueToEntry(alpha, info.curDepth);
+	newEntryData.bestMove = bestMove;
+	newEntryData.depth = MIN(info.depthRemaining, UINT8_MAX);
+	newEntryData.bound = (alpha > originalAlpha) ? TRANSPOS_BOUND_EXACT : TRANSPOS_BOUND_UPPER;
+	newEntryData.generation = Transpos::main.generation;
+	if (canStoreEntry)
+		entry->Store(boardState.hash, newEntryData);
+
 	return alpha;
 }
 
-uint8_t Engine::DoSearch(uint16_t depth, size_t maxTimeMS) {
+// Runs a single search from the root at a given depth and window
+Value SearchRoot(SearchThreadData& thread, BoardState& rootBoardState, uint16_t depth, Value alpha, Value beta) {
+	// Create search info
+	SearchInfo searchInfo = {};
+	searchInfo.depthRemaining = depth;
+
+	NNUE::ResetAccumulator(thread.accumulators[0]);
+
+	if (rootBoardState.turnTeam == TEAM_WHITE) {
+		return MinMaxSearchRecursive<TEAM_WHITE>(thread, rootBoardState, alpha, beta, searchInfo, thread.frames);
+	} else {
+		return MinMaxSearchRecursive<TEAM_BLACK>(thread, rootBoardState, alpha, beta, searchInfo, thread.frames);
+	}
+}
+
+// Runs a single iteration of iterative deepening at a given depth
+// The eval usually doesn't change much between iterations, so we first search a narrow "aspiration" window around
+//	the previous iteration's eval, which prunes much more than a full window
+// If the true eval falls outside of it, the window is widened on that side and the search is repeated
+Value SearchIteration(SearchThreadData& thread, BoardState& rootBoardState, uint16_t depth, Value prevEval) {
+	constexpr Value
+		FULL_WINDOW = CHECKMATE_VALUE * 2,
+		ASPIRATION_WINDOW = 50;
+	constexpr uint16_t ASPIRATION_MIN_DEPTH = 4; // Evals at lower depths are too unstable
+
+	if (depth < ASPIRATION_MIN_DEPTH || abs(prevEval) >= CHECKMATE_VALUE)
+		return SearchRoot(thread, rootBoardState, depth, -FULL_WINDOW, FULL_WINDOW);
+
+	Value delta = ASPIRATION_WINDOW;
+	Value
+		alpha = MAX(prevEval - delta, -FULL_WINDOW),
+		beta = MIN(prevEval + delta, FULL_WINDOW);
+
+	while (true) {
+		Value eval = SearchRoot(thread, rootBoardState, depth, alpha, beta);
+		if (g_StopSearch)
+			return eval;
+
+		delta *= 4;
+		if (eval <= alpha && alpha > -FULL_WINDOW) {
+			thread.stats.aspirationFailLows++;
+			alpha = (delta >= CHECKMATE_VALUE) ? -FULL_WINDOW : MAX(eval - delta, -FULL_WINDOW);
+		} else if (eval >= beta && beta < FULL_WINDOW) {
+			thread.stats.aspirationFailHighs++;
+			beta = (delta >= CHECKMATE_VALUE) ? FULL_WINDOW : MIN(eval + delta, FULL_WINDOW);
+		} else {
+			return eval;
+		}
+	}
+}
+
+// Lazy SMP helper: searches the same root as the main thread, purely to fill the shared transposition table
+// Odd helpers start one ply deeper so that the threads aren't all searching the same depth at the same time
+void HelperSearchLoop(SearchThreadData* thread, BoardState rootBoardState, uint16_t maxDepth) {
+	uint16_t depthOffset = thread->index % 2;
+	Value prevEval = 0;
+	for (uint16_t curDepth = 1 + depthOffset; (curDepth <= maxDepth) && (!g_StopSearch); curDepth++) {
+		prevEval = SearchIteration(*thread, rootBoardState, curDepth, prevEval);
+
+		if (g_StopSearch)
+			break;
+
+		infoMutex.lock();
+		g_HelperStats[thread->index - 1] = thread->stats;
+		infoMutex.unlock();
+	}
+}
+
+// Best line found from the root, for one MultiPV slot
+struct RootLine {
+	Value eval = 0;
+	Move pv[MAX_SEARCH_DEPTH];
+	uint16_t pvLength = 0;
+};
+
+void PrintLineInfo(uint16_t depth, size_t lineIndex, const RootLine& line, uint64_t totalNodes, int64_t msElapsed) {
+	std::stringstream uciInfo;
+	uciInfo << "info";
+	uciInfo << " depth " << depth;
+	uciInfo << " multipv " << (lineIndex + 1);
+
+	if (abs(line.eval) >= CHECKMATE_VALUE) {
+		size_t remainingMovesTilCheckmate = line.pvLength;
+		bool weWin = (line.eval > 0);
+
+		size_t mateInMoveCount = (remainingMovesTilCheckmate + weWin) / 2;
+		uciInfo << " mate " << (weWin ? "" : "-") << mateInMoveCount;
+	} else {
+		uciInfo << " score cp " << line.eval;
+	}
+	uciInfo << " nodes " << totalNodes;
+
+	size_t nps = (size_t)(totalNodes / (MAX(msElapsed, 500) / 1000.f));
+	uciInfo << " nps " << nps;
+	uciInfo << " time " << msElapsed;
+
+	uciInfo << " pv ";
+	for (int i = 0; i < line.pvLength; i++) {
+		uciInfo << line.pv[i] << ' ';
+	}
+	LOG(uciInfo.str());
+}
+
+uint8_t Engine::DoSearch(uint16_t depth, const TimeControl& timeControl, bool ponder, uint64_t maxNodes, const vector<Move>& searchMoves) {
 	ASSERT(depth > 0);
 
 #ifdef _DEBUG
@@ -345,11 +910,11 @@ uint8_t Engine::DoSearch(uint16_t depth, size_t maxTimeMS) {
 	depth = MIN(depth, MAX_SEARCH_DEPTH);
 #endif
 
-	size_t startTimeMS = CUR_MS();
 	uint8_t previousState = STATE_READY;
 
 	BoardState initialBoardState = GetPosition();
 	infoMutex.lock();
+	vector<ZobristHash> positionHistory = g_PositionHistory;
 	g_Stats = Stats();
 	{
 		if (g_CurState != STATE_READY) {
@@ -367,124 +932,175 @@ uint8_t Engine::DoSearch(uint16_t depth, size_t maxTimeMS) {
 
 	MoveList initialMoves;
 	MoveGen::GetMoves(initialBoardState, initialMoves);
-	bool isWhite = (initialBoardState.turnTeam == TEAM_WHITE);
+
+	// Only keep the moves we were told to search, if any
+	// NOTE: If none of them are legal, we search all moves rather than having no move to play
+	vector<uint16_t> rootSearchMoves;
+	if (!searchMoves.empty()) {
+		MoveList allowedMoves;
+		for (const Move& move : initialMoves) {
+			auto isSameMove = [&](const Move& searchMove) { return searchMove.Pack() == move.Pack(); };
+			if (std::find_if(searchMoves.begin(), searchMoves.end(), isSameMove) != searchMoves.end()) {
+				allowedMoves.Add(move);
+				rootSearchMoves.push_back(move.Pack());
+			}
+		}
+
+		if (allowedMoves.size > 0)
+			initialMoves = allowedMoves;
+	}
 
 	if (initialMoves.size > 0) {
 
-		// Mark old transpos entries
-		Transpos::main.MarkOld();
+		// Age all existing transpos entries by one search
+		Transpos::main.NewSearch();
+
+		g_TimeManager.Start(timeControl, initialBoardState.turnTeam);
+		g_IsPondering = ponder;
+		g_NodeLimit = (maxNodes > 0) ? maxNodes : UINT64_MAX;
+		g_UseNNUE = g_Settings.useNNUE && NNUE::IsLoaded();
+
+		// Create thread data
+		size_t threadCount = CLAMP(g_Settings.threadCount, 1, MAX_SEARCH_THREADS);
+		while (g_SearchThreads.size() < threadCount)
+			g_SearchThreads.push_back(std::make_unique<SearchThreadData>());
+		g_SearchThreads.resize(threadCount);
+
+		for (size_t i = 0; i < threadCount; i++) {
+			SearchThreadData& thread = *g_SearchThreads[i];
+			thread.index = i;
+			thread.stats = Stats();
+			thread.nodesUntilLimitCheck = SEARCH_LIMIT_CHECK_INTERVAL;
+			thread.rootSearchMoves = rootSearchMoves;
+
+			// Killers from the last search are for a different position
+			for (SearchFrame& frame : thread.frames)
+				std::fill(frame.killers, frame.killers + KILLER_MOVE_AMOUNT, 0);
+
+			// Moves before the root aren't tracked
+			thread.frames[0].prevMoves[0] = thread.frames[0].prevMoves[1] = Move();
+
+			// History is kept between searches, but weakened as it was for a different position
+			thread.butterflyBoard.Age();
+			for (ContHistory& contHistory : thread.contHistories)
+				contHistory.Age();
+
+			thread.hashStack = positionHistory;
+			thread.hashStack.reserve(positionHistory.size() + MAX_SEARCH_DEPTH);
+		}
 
-		// Invalidate first PV move
-		g_FirstBestMoveIdx = MAX_MOVES;
+		infoMutex.lock();
+		g_HelperStats.assign(threadCount - 1, Stats());
+		infoMutex.unlock();
+
+		SearchThreadData& mainThread = *g_SearchThreads[0];
+
+		// Start helper threads
+		vector<std::thread> helperThreads;
+		for (size_t i = 1; i < threadCount; i++)
+			helperThreads.push_back(std::thread(HelperSearchLoop, g_SearchThreads[i].get(), initialBoardState, depth));
 
 		// Iterative deepening search
+		// Every iteration searches each MultiPV line in turn, each excluding the best moves of the lines before it
+		size_t lineCount = CLAMP(g_Settings.multiPV, 1, initialMoves.size);
+		vector<RootLine> lines = vector<RootLine>(lineCount), newLines = vector<RootLine>(lineCount);
 		for (uint16_t curDepth = 1; (curDepth <= depth) && (!g_StopSearch); curDepth++) {
-			size_t msElapsed = CUR_MS() - startTimeMS;
-			if (msElapsed > maxTimeMS && maxTimeMS > 0)
-				break;
-
 			DLOG("Searching at depth " << curDepth << "/" << depth << "...");
 
-			const auto fnMinMaxSearch = [](uint8_t team, auto&&... args) -> Value {
-				g_ButterflyBoard.Reset();
-
-				if (team == TEAM_WHITE) {
-					return MinMaxSearchRecursive<TEAM_WHITE>(args...);
-				} else {
-					return MinMaxSearchRecursive<TEAM_BLACK>(args...);
-				}
-			};
+			mainThread.rootExcludedMoves.clear();
+			size_t lineIndex = 0;
+			for (; lineIndex < lineCount; lineIndex++) {
+				// Run recursive search
+				// NOTE: Lines are sorted by eval, so the previous eval of this line index is the best guess for aspiration
+				Value eval = SearchIteration(mainThread, initialBoardState, curDepth, lines[lineIndex].eval);
+				if (g_StopSearch)
+					break;
 
-			// Create search info
-			SearchInfo searchInfo = {};
-			searchInfo.depthRemaining = curDepth;
-			ASSERT(g_Settings.maxExtendedDepth <= MAX_EXTENDED_DEPTH);
-			searchInfo.extendedDepthRemaining = g_Settings.maxExtendedDepth;
+				const SearchFrame& rootFrame = mainThread.frames[0];
+				ASSERT(rootFrame.pvLength > 0);
 
-			// Create frames
-			SearchFrame frames[MAX_SEARCH_DEPTH + MAX_EXTENDED_DEPTH] = {};
+				RootLine& line = newLines[lineIndex];
+				line.eval = eval;
+				line.pvLength = rootFrame.pvLength;
+				std::copy(rootFrame.pv, rootFrame.pv + rootFrame.pvLength, line.pv);
 
-			// Run recursive search
-			Value bestRelativeEval = fnMinMaxSearch(
-				isWhite ? TEAM_WHITE : TEAM_BLACK,
-				initialBoardState, -CHECKMATE_VALUE * 2, CHECKMATE_VALUE * 2, searchInfo, frames
-			);
+				mainThread.rootExcludedMoves.push_back(line.pv[0].Pack());
+			}
 
-			if (g_StopSearch) // We stopped early, don't update PV or print info as it is invalid
+			if (g_StopSearch) {
+				// We stopped mid-iteration, so the eval is invalid and we don't print info
+				// However, if a root move has been completely searched at this depth and raised alpha, it is our best move
+				const SearchFrame& rootFrame = mainThread.frames[0];
+				infoMutex.lock();
+				if (lineIndex > 0) {
+					// The first line finished, anything after it excluded the best move
+					std::copy(newLines[0].pv, newLines[0].pv + newLines[0].pvLength, g_CurPV);
+					g_CurPVLength = newLines[0].pvLength;
+				} else if (rootFrame.pvLength > 0) {
+					std::copy(rootFrame.pv, rootFrame.pv + rootFrame.pvLength, g_CurPV);
+					g_CurPVLength = rootFrame.pvLength;
+				} else if (g_CurPVLength == 0) {
+					// Not even the first iteration finished, any legal move is better than none
+					g_CurPV[0] = initialMoves[0];
+					g_CurPVLength = 1;
+				}
+				infoMutex.unlock();
 				break;
+			}
+
+			// A later line can come out better than an earlier one, as each search sees a different set of moves
+			std::stable_sort(newLines.begin(), newLines.end(),
+				[](const RootLine& a, const RootLine& b) { return a.eval > b.eval; }
+			);
+			std::swap(lines, newLines);
 
 			// Update PV
 			infoMutex.lock();
 			{
+				std::copy(lines[0].pv, lines[0].pv + lines[0].pvLength, g_CurPV);
+				g_CurPVLength = lines[0].pvLength;
 
-				g_CurPVLength = 1;
-				BoardState pvBoardState = initialBoardState;
-				pvBoardState.ForceUpdateAll();
-
-				MoveList firstMoves;
-				MoveGen::GetMoves(pvBoardState, firstMoves);
-
-				if (g_FirstBestMoveIdx < firstMoves.size) {
-					g_CurPV[0] = firstMoves[g_FirstBestMoveIdx];
-				} else {
-					g_CurPV[0] = {}; // Invalid
-					ASSERT(false);
-				}
-
-				Move firstMove = g_CurPV[0];
-				pvBoardState.ExecuteMove(firstMove);
-
-				for (size_t i = 1; i < curDepth; i++) {
-					TransposEntry* entry = Transpos::main.Find(pvBoardState.hash);
-					if (entry->fullHash == pvBoardState.hash) {
-						MoveList moves;
-						MoveGen::GetMoves(pvBoardState, moves);
-						if (entry->bestMoveTrueIndex < moves.size) {
-							Move bestMove = moves[entry->bestMoveTrueIndex];
-							pvBoardState.ExecuteMove(bestMove);
-							g_CurPV[i] = bestMove;
-							g_CurPVLength++;
-						} else {
-							// Hash collision!
-							break;
-						}
-					} else {
-						// Failed to find
-						break;
-					}
-				}
+				g_Stats = mainThread.stats;
+				for (const Stats& helperStats : g_HelperStats)
+					g_Stats.Accumulate(helperStats);
 			}
 			infoMutex.unlock();
 
 			{ // Print UCI info
 				// TODO: Move this all to UCI.cpp, use a callback function to trigger print
-				std::stringstream uciInfo;
-				uciInfo << "info";
-				uciInfo << " depth " << curDepth;
-				uciInfo << " multipv 1"; // TODO: Support multi-PV
-
-				if (abs(bestRelativeEval) >= CHECKMATE_VALUE) {
-					size_t remainingMovesTilCheckmate = g_CurPVLength;
-					bool weWin = (bestRelativeEval > 0);
-
-					size_t mateInMoveCount = (remainingMovesTilCheckmate + weWin) / 2;
-					uciInfo << " mate " << (weWin ? "" : "-") << mateInMoveCount;
-				} else {
-					uciInfo << " score cp " << bestRelativeEval;
-				}
-				uciInfo << " nodes " << g_Stats.leafNodesEvaluated;
+				uint64_t totalNodes = g_Stats.nodesSearched + g_Stats.qsearchNodes;
+				int64_t msElapsed = g_TimeManager.GetElapsedMS();
+				for (size_t i = 0; i < lineCount; i++)
+					PrintLineInfo(curDepth, i, lines[i], totalNodes, msElapsed);
+
+				// Not part of the UCI protocol, but useful for seeing how much of the tree is quiescence search
+				// NOTE: Only in debug builds, as GUIs just show these as noise (the counters are still in g_Stats)
+				DLOG("info string qsearch nodes " << g_Stats.qsearchNodes << " (" << (g_Stats.qsearchNodes * 100 / MAX(totalNodes, 1)) << "%)");
+				DLOG(
+					"info string re-searches pvs " << g_Stats.pvsReSearches <<
+					" aspiration low " << g_Stats.aspirationFailLows << " high " << g_Stats.aspirationFailHighs
+				);
+			}
 
-				size_t nps = (size_t)(g_Stats.leafNodesEvaluated / (MAX(msElapsed, 500) / 1000.f));
-				uciInfo << " nps " << nps;
-				uciInfo << " time " << msElapsed;
+			// NOTE: Locked as PonderHit() can restart the time manager from another thread
+			infoMutex.lock();
+			bool shouldStop = g_TimeManager.OnIterationComplete(lines[0].pv[0].Pack(), lines[0].eval) && !g_IsPondering;
+			infoMutex.unlock();
 
-				uciInfo << " pv ";
-				for (int i = 0; i < g_CurPVLength; i++) {
-					uciInfo << g_CurPV[i] << ' ';
-				}
-				LOG(uciInfo.str());
-			}
+			if (shouldStop)
+				break;
 		}
+		mainThread.rootExcludedMoves.clear();
+
+		// UCI doesn't allow a move to be reported while pondering, even if we have nothing left to search
+		while (g_IsPondering && !g_StopSearch)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		g_IsPondering = false;
+
+		// The main thread is done, so the helpers are too
+		g_StopSearch = true;
+		for (std::thread& helperThread : helperThreads)
+			helperThread.join();
 	}
 
 	infoMutex.lock();
@@ -499,14 +1115,36 @@ uint8_t Engine::DoSearch(uint16_t depth, size_t maxTimeMS) {
 }
 
 void PerftSearchRecursive(BoardState& boardState, uint16_t depth, uint64_t& moveCount) {
+	boardState.UpdateIfNeeded(!boardState.turnTeam);
+
 	if (depth > 1) {
+		bool useCache = PerftCache::main.IsEnabled();
+
+		uint64_t subtreeMoveCount = 0;
+		if (useCache && PerftCache::main.Find(boardState.hash, depth, subtreeMoveCount)) {
+			moveCount += subtreeMoveCount;
+			return;
+		}
+
 		MoveGen::GetMoves(boardState,
 			[&](const Move& move) {
+#ifdef MAKE_UNMAKE
+				MoveUndo undo;
+				boardState.ExecuteMove(move, undo);
+				PerftSearchRecursive(boardState, depth - 1, subtreeMoveCount);
+				boardState.UndoMove(move, undo);
+#else
 				BoardState boardCopy = boardState;
 				boardCopy.ExecuteMove(move);
-				PerftSearchRecursive(boardCopy, depth - 1, moveCount);
+				PerftSearchRecursive(boardCopy, depth - 1, subtreeMoveCount);
+#endif
 			}
 		);
+
+		if (useCache)
+			PerftCache::main.Store(boardState.hash, depth, subtreeMoveCount);
+
+		moveCount += subtreeMoveCount;
 	} else {
 		MoveGen::CountMoves(boardState, moveCount);
 	}
@@ -535,30 +1173,81 @@ uint8_t Engine::DoPerftSearch(uint16_t depth) {
 
 	uint64_t totalMoves = 0;
 
-	bool stopped = false;
-
-	MoveGen::GetMoves(initialBoardState,
-		[&](const Move& move) {
-			if (depth > 1) {
-
-				if (g_StopSearch || stopped) {
-					stopped = true;
-					return;
+	MoveList rootMoves;
+	MoveGen::GetMoves(initialBoardState, rootMoves);
+
+	// Number of nodes under each root move
+	// NOTE: Atomic as work items under the same root move can finish on different threads
+	vector<std::atomic<uint64_t>> rootMoveCounts(rootMoves.size);
+
+	// A subtree to be counted by any worker thread
+	struct PerftWorkItem {
+		size_t rootMoveIndex;
+		BoardState boardState;
+		uint16_t depthRemaining;
+	};
+
+	// Split the tree into work items
+	// When deep enough, we split at 2 plies instead of at the root, as there are often fewer root moves than threads,
+	//	and the size of each root move's subtree varies a lot
+	vector<PerftWorkItem> workItems;
+	for (size_t i = 0; i < rootMoves.size; i++) {
+		BoardState boardCopy = initialBoardState;
+		boardCopy.ExecuteMove(rootMoves[i]);
+		boardCopy.UpdateIfNeeded(!boardCopy.turnTeam);
+
+		if (depth > 2) {
+			MoveGen::GetMoves(boardCopy,
+				[&](const Move& move) {
+					BoardState subBoardCopy = boardCopy;
+					subBoardCopy.ExecuteMove(move);
+					workItems.push_back({ i, subBoardCopy, (uint16_t)(depth - 2) });
 				}
+			);
+		} else if (depth > 1) {
+			workItems.push_back({ i, boardCopy, (uint16_t)(depth - 1) });
+		} else {
+			rootMoveCounts[i] = 1;
+		}
+	}
 
-				BoardState boardCopy = initialBoardState;
-				boardCopy.ExecuteMove(move);
+	std::atomic<size_t> nextWorkItemIndex = 0;
+	std::atomic<bool> stopped = false;
 
-				uint64_t totalSubMoves = 0;
-				PerftSearchRecursive(boardCopy, depth - 1, totalSubMoves);
-				LOG(move << ": " << totalSubMoves);
-				totalMoves += totalSubMoves;
-			} else {
-				LOG(move << ": 1");
-				totalMoves++;
+	const auto fnPerftWorker = [&]() {
+		while (true) {
+			size_t workItemIndex = nextWorkItemIndex++;
+			if (workItemIndex >= workItems.size())
+				break;
+
+			if (g_StopSearch) {
+				stopped = true;
+				break;
 			}
+
+			PerftWorkItem& workItem = workItems[workItemIndex];
+			uint64_t subMoveCount = 0;
+			PerftSearchRecursive(workItem.boardState, workItem.depthRemaining, subMoveCount);
+			rootMoveCounts[workItem.rootMoveIndex] += subMoveCount;
 		}
-	);
+	};
+
+	// The calling thread works too
+	size_t threadCount = CLAMP(g_Settings.threadCount, 1, MAX_SEARCH_THREADS);
+	vector<std::thread> workerThreads;
+	for (size_t i = 1; i < threadCount; i++)
+		workerThreads.push_back(std::thread(fnPerftWorker));
+	fnPerftWorker();
+	for (std::thread& workerThread : workerThreads)
+		workerThread.join();
+
+	if (!stopped) {
+		// Print divide results in generation order, regardless of which thread finished first
+		for (size_t i = 0; i < rootMoves.size; i++) {
+			LOG(rootMoves[i] << ": " << rootMoveCounts[i]);
+			totalMoves += rootMoveCounts[i];
+		}
+	}
 
 	if (!stopped) {
 		uint64_t timeElapsed = CUR_MS() - startTimeMS;
@@ -591,5 +1280,7 @@ uint8_t Engine::DoPerftSearch(uint16_t depth) {
 	}
 	infoMutex.unlock();
 
+	g_StopSearch = false;
+
 	return SEARCH_COMPLETED;
 }
\ No newline at end of file
@@ -1,9 +1,13 @@
 #pragma once
 #include "BoardState/BoardState.h"
 #include "LookupGen/LookupGen.h"
+#include "TimeManager/TimeManager.h"
 
 #define MAX_SEARCH_DEPTH 256
-#define MAX_EXTENDED_DEPTH 16
+// Maximum plies of quiescence search below the main search
+#define MAX_QSEARCH_DEPTH 32
+#define MAX_SEARCH_THREADS 256
+#define MAX_MULTI_PV 256
 
 namespace Engine {
 
@@ -14,7 +18,13 @@ namespace Engine {
 		// The last depth of the completed iteration
 		uint16_t completedDepth;
 
-		// Number of positions reached at depth 0
+		// Number of positions visited by the main search (not including quiescence search)
+		uint64_t nodesSearched;
+
+		// Number of positions visited by quiescence search
+		uint64_t qsearchNodes;
+
+		// Number of positions statically evaluated
 		uint64_t leafNodesEvaluated; 
 
 		// Number of times we found a position within the transposition table
@@ -25,8 +35,8 @@ namespace Engine {
 		uint64_t transposOverrides;
 
 		// Number of times the transposition table returned a position with a matching hash,
-		//	but an invalid move index (hash collision)
-		uint64_t transposBadMoveIndices;
+		//	but a best move that isn't legal here (hash collision)
+		uint64_t transposBadMoves;
 
 		// Number of checkmates found in the current search (for either color)
 		uint64_t matesFound;
@@ -34,12 +44,42 @@ namespace Engine {
 		// Number of stalemates found in the current search (for either color)
 		uint64_t stalematesFound;
 
+		// Number of times a null-window search beat alpha, so the move had to be searched again with the full window
+		uint64_t pvsReSearches;
+
+		// Number of root searches that fell outside of the aspiration window and had to be repeated with a wider one
+		uint64_t aspirationFailLows, aspirationFailHighs;
+
 		Stats() = default;
+
+		// Adds the counters of another thread's stats to ours
+		void Accumulate(const Stats& other) {
+			nodesSearched += other.nodesSearched;
+			qsearchNodes += other.qsearchNodes;
+			leafNodesEvaluated += other.leafNodesEvaluated;
+			transposHits += other.transposHits;
+			transposOverrides += other.transposOverrides;
+			transposBadMoves += other.transposBadMoves;
+			matesFound += other.matesFound;
+			stalematesFound += other.stalematesFound;
+			pvsReSearches += other.pvsReSearches;
+			aspirationFailLows += other.aspirationFailLows;
+			aspirationFailHighs += other.aspirationFailHighs;
+		}
 	};
 
 	struct Settings {
-		// Maximum extra plies to search if reached a capture or check at depth 0
-		uint16_t maxExtendedDepth = 6;
+		// Also search quiet moves that give check at the first ply of quiescence search
+		bool quiescenceChecks = true;
+
+		// Number of threads to search with (Lazy SMP), the main thread plus (threadCount - 1) helpers
+		uint16_t threadCount = 1;
+
+		// Number of best lines to search and report (MultiPV), each costs about as much as a normal search
+		uint16_t multiPV = 1;
+
+		// Evaluate with the NNUE network instead of the hand-crafted eval, if one is loaded
+		bool useNNUE = true;
 	};
 
 	enum {
@@ -57,7 +97,8 @@ namespace Engine {
 
 	Stats GetStats(); // NOTE: Stats are reset every new search
 
-	void SetPosition(const BoardState& state);
+	// History is the hashes of all previous positions in the game, oldest first (used for repetition detection)
+	void SetPosition(const BoardState& state, const vector<ZobristHash>& history = {});
 
 	enum {
 		SEARCH_COULDNT_START,
@@ -65,7 +106,17 @@ namespace Engine {
 		SEARCH_COMPLETED
 	};
 
-	uint8_t DoSearch(uint16_t depth, size_t maxTimeMS = -1);
+	// If ponder is set, time limits are ignored until PonderHit() is called
+	// If maxNodes is non-zero, the search stops after the main thread has searched that many nodes
+	// If searchMoves isn't empty, only those root moves are searched
+	uint8_t DoSearch(
+		uint16_t depth, const TimeControl& timeControl = TimeControl(), bool ponder = false,
+		uint64_t maxNodes = 0, const vector<Move>& searchMoves = {}
+	);
+
+	// The opponent played the move we were pondering on, so continue the search as a normal timed search
+	void PonderHit();
+
 	uint8_t DoPerftSearch(uint16_t depth);
 	void StopSearch();
 }
\ No newline at end of file
@@ -31,6 +31,12 @@ struct Move {
 		return from != to;
 	}
 
+	// Packs the from, to, and result piece into 16 bits
+	// NOTE: A valid move never packs to 0
+	FINLINE uint16_t Pack() const {
+		return from.index | (to.index << 6) | (resultPiece << 12);
+	}
+
 	friend std::ostream& operator<<(std::ostream& stream, const Move& move);
 };
 
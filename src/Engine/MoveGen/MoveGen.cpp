@@ -77,8 +77,10 @@ FINLINE void AddMovesFromBB(Pos from, BitBoard toBB, BitBoard enemyOccupy, CALLB
 	}
 }
 
-template <uint8_t TEAM, bool EN_PASSANT_AVAILABLE, bool ONLY_KING_MOVES, bool JUST_COUNT, typename CALLBACK>
-FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBACK callbackOrCount) {
+// GEN_TYPE: Which kind of moves to generate (see MoveGen::GEN_ALL)
+// fromMask: Only generate moves of pieces in this mask
+template <uint8_t TEAM, bool EN_PASSANT_AVAILABLE, bool ONLY_KING_MOVES, bool JUST_COUNT, uint8_t GEN_TYPE, typename CALLBACK>
+FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, BitBoard fromMask, CALLBACK callbackOrCount) {
 	auto& td = board.teamData[TEAM];
 	auto& etd = board.teamData[!TEAM];
 
@@ -88,6 +90,11 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 		enemyOccupy = etd.occupy;
 	BitBoard combinedOccupy = teamOccupy | enemyOccupy;
 
+	BitBoard enPassantToMask = board.GetEnPassantToMask();
+
+	// Squares that pawns can move to that make the move noisy
+	BitBoard pawnNoisyMask = enemyOccupy | enPassantToMask | BB_MASK_RANK(0) | BB_MASK_RANK(7);
+
 	if constexpr (!ONLY_KING_MOVES) {
 
 		BitBoard checkBlockPathMask = BitBoard::Filled();
@@ -95,6 +102,11 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 			checkBlockPathMask = LookupGen::GetPartialLineMask(etd.firstCheckingPiecePos, td.kingPos) | etd.checkers;
 
 		BitBoard normalMoveMask = checkBlockPathMask & teamOccupyInv;
+		if constexpr (GEN_TYPE == MoveGen::GEN_NOISY) {
+			normalMoveMask &= enemyOccupy;
+		} else if constexpr (GEN_TYPE == MoveGen::GEN_QUIET) {
+			normalMoveMask &= ~enemyOccupy;
+		}
 
 		BitBoard pinnedPieces = td.pinnedPieces;
 
@@ -103,7 +115,7 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 
 		BitBoard pieces;
 		
-		pieces = td.pieceSets[PT_PAWN] & teamOccupy;
+		pieces = td.pieceSets[PT_PAWN] & teamOccupy & fromMask;
 		pieces.Iterate(
 			[&](uint64_t _i) {
 				Pos i = _i;
@@ -123,13 +135,13 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 				BitBoard attacks = baseAttacks & enemyOccupy;
 
 				if constexpr (EN_PASSANT_AVAILABLE) {
-					if (baseAttacks & board.enPassantToMask) {
+					if (baseAttacks & enPassantToMask) {
 						bool isLegal = true;
 
 						if (pinnedPieces[board.enPassantPawnPos]) {
 							// If the target pawn is pinned, make sure capturing it blocks the pin
 							BitBoard enemyPawnPinMask = LookupGen::GetLineMask(board.enPassantPawnPos, td.kingPos);
-							isLegal = board.enPassantToMask & enemyPawnPinMask;
+							isLegal = enPassantToMask & enemyPawnPinMask;
 						}
 
 						if (td.kingPos.Y() == moveFromY && isLegal) {
@@ -161,7 +173,7 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 						}
 						
 						if (isLegal) {
-							attacks |= board.enPassantToMask;
+							attacks |= enPassantToMask;
 						}
 					}
 				}
@@ -171,20 +183,26 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 				if constexpr (EN_PASSANT_AVAILABLE) {
 					// FIX FOR SPECIAL CASE: Allow en passant to capture a checking pawn
 					if (checkersAmount && etd.firstCheckingPiecePos == board.enPassantPawnPos) {
-						moves |= attacks & board.enPassantToMask;
+						moves |= attacks & enPassantToMask;
 					}
 				}
 
 				if (pinnedPieces[i])
 					moves &= LookupGen::GetLineMask(i, td.kingPos);
 
+				if constexpr (GEN_TYPE == MoveGen::GEN_NOISY) {
+					moves &= pawnNoisyMask;
+				} else if constexpr (GEN_TYPE == MoveGen::GEN_QUIET) {
+					moves &= ~pawnNoisyMask;
+				}
+
 				if constexpr (JUST_COUNT) {
 					AddMovesFromBB<PT_PAWN, true>(i, moves, 0, callbackOrCount);
 				} else {
 					BitBoard captureBB = etd.occupy;
 
 					if constexpr (EN_PASSANT_AVAILABLE) {
-						captureBB |= board.enPassantToMask;
+						captureBB |= enPassantToMask;
 					}
 
 					AddMovesFromBB<PT_PAWN, false>(i, moves, captureBB, callbackOrCount);
@@ -192,7 +210,7 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 			}
 		);
 
-		pieces = td.pieceSets[PT_ROOK];
+		pieces = td.pieceSets[PT_ROOK] & fromMask;
 		pieces.Iterate(
 			[&](uint64_t i) {
 				BitBoard baseMoves, moves;
@@ -205,7 +223,7 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 			}
 		);
 
-		pieces = td.pieceSets[PT_KNIGHT];
+		pieces = td.pieceSets[PT_KNIGHT] & fromMask;
 		pieces.Iterate(
 			[&](uint64_t i) {
 				BitBoard moves = LookupGen::GetKnightMoves(i) & normalMoveMask;
@@ -216,7 +234,7 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 			}
 		);
 
-		pieces = td.pieceSets[PT_BISHOP];
+		pieces = td.pieceSets[PT_BISHOP] & fromMask;
 		pieces.Iterate(
 			[&](uint64_t i) {
 				BitBoard baseMoves, moves;
@@ -229,7 +247,7 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 			}
 		);
 
-		pieces = td.pieceSets[PT_QUEEN];
+		pieces = td.pieceSets[PT_QUEEN] & fromMask;
 		pieces.Iterate(
 			[&](uint64_t i) {
 				BitBoard baseMoves, moves;
@@ -243,11 +261,17 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 		);
 	}
 
-	{ // King
+	if (fromMask[td.kingPos]) { // King
 		BitBoard moves = LookupGen::GetKingMoves(td.kingPos) & teamOccupyInv & ~etd.attack;
 
+		if constexpr (GEN_TYPE == MoveGen::GEN_NOISY) {
+			moves &= enemyOccupy;
+		} else if constexpr (GEN_TYPE == MoveGen::GEN_QUIET) {
+			moves &= ~enemyOccupy;
+		}
+
 		// Castling
-		if (checkersAmount == 0) {
+		if (checkersAmount == 0 && GEN_TYPE != MoveGen::GEN_NOISY) {
 			for (int i = 0; i < 2; i++) {
 				bool canCastle = i ? td.canCastle_K : td.canCastle_Q;
 				if (canCastle) {
@@ -279,22 +303,25 @@ FINLINE void _GetMoves(const BoardState& board, uint64_t checkersAmount, CALLBAC
 
 #define KM_G(team, enPassant, justCount) \
 	if (onlyKingMoves) \
-		_GetMoves<team, enPassant, 1, JUST_COUNT>(board, checkersAmount, callbackOrCount); \
+		_GetMoves<team, enPassant, 1, JUST_COUNT, GEN_TYPE>(board, checkersAmount, fromMask, callbackOrCount); \
 	else \
-		_GetMoves<team, enPassant, 0, JUST_COUNT>(board, checkersAmount, callbackOrCount);
+		_GetMoves<team, enPassant, 0, JUST_COUNT, GEN_TYPE>(board, checkersAmount, fromMask, callbackOrCount);
+
+template <bool JUST_COUNT, uint8_t GEN_TYPE, typename T>
+void _GetMovesWrapper(const BoardState& board, T callbackOrCount, BitBoard fromMask = BitBoard::Filled()) {
+	// The enemy's attacks, checkers and our pinned pieces are all computed by the enemy's update
+	ASSERT(!board.teamData[!board.turnTeam].needsUpdate);
 
-template <bool JUST_COUNT, typename T>
-void _GetMovesWrapper(const BoardState& board, T callbackOrCount) {
 	int checkersAmount = board.teamData[!board.turnTeam].checkers.BitCount();
 	bool onlyKingMoves = checkersAmount > 1;
 	if (board.turnTeam == TEAM_WHITE) {
-		if (board.enPassantToMask) {
+		if (board.enPassantToPos) {
 			KM_G(TEAM_WHITE, true);
 		} else {
 			KM_G(TEAM_WHITE, false);
 		}
 	} else {
-		if (board.enPassantToMask) {
+		if (board.enPassantToPos) {
 			KM_G(TEAM_BLACK, true);
 		} else {
 			KM_G(TEAM_BLACK, false);
@@ -302,22 +329,40 @@ void _GetMovesWrapper(const BoardState& board, T callbackOrCount) {
 	}
 }
 
-void MoveGen::GetMoves(const BoardState& board, MoveList& movesOut) {
+template <uint8_t GEN_TYPE>
+FINLINE void _GetMovesToList(const BoardState& board, MoveList& movesOut, BitBoard fromMask = BitBoard::Filled()) {
 	uint16_t curTrueIndex = 0;
-	_GetMovesWrapper<false>(board, 
-		[&](Move& move) { 
+	_GetMovesWrapper<false, GEN_TYPE>(board,
+		[&](Move& move) {
 			move.trueIndex = curTrueIndex;
 			curTrueIndex++;
 
 			movesOut.Add(move);
-		}
+		},
+		fromMask
 	);
 }
 
+void MoveGen::GetMoves(const BoardState& board, MoveList& movesOut) {
+	_GetMovesToList<GEN_ALL>(board, movesOut);
+}
+
 void MoveGen::GetMoves(const BoardState& board, MoveCallbackFn callback) {
-	_GetMovesWrapper<false>(board, callback);
+	_GetMovesWrapper<false, GEN_ALL>(board, callback);
+}
+
+void MoveGen::GetNoisyMoves(const BoardState& board, MoveList& movesOut) {
+	_GetMovesToList<GEN_NOISY>(board, movesOut);
+}
+
+void MoveGen::GetQuietMoves(const BoardState& board, MoveList& movesOut) {
+	_GetMovesToList<GEN_QUIET>(board, movesOut);
+}
+
+void MoveGen::GetMovesFrom(const BoardState& board, Pos from, MoveList& movesOut) {
+	_GetMovesToList<GEN_ALL>(board, movesOut, 1ull << from);
 }
 
 void MoveGen::CountMoves(const BoardState& board, uint64_t& moveCount) {
-	_GetMovesWrapper<true>(board, std::ref(moveCount));
+	_GetMovesWrapper<true, GEN_ALL>(board, std::ref(moveCount));
 }
\ No newline at end of file
@@ -4,7 +4,19 @@
 typedef std::function<void(const Move& move)> MoveCallbackFn;
 
 namespace MoveGen {
+	enum {
+		GEN_ALL,
+		GEN_NOISY, // Captures (including en passant) and promotions
+		GEN_QUIET, // Everything that isn't noisy
+	};
+
 	void GetMoves(const BoardState& board, MoveList& movesOut);
 	void GetMoves(const BoardState& board, MoveCallbackFn callbackFn);
+
+	void GetNoisyMoves(const BoardState& board, MoveList& movesOut);
+	void GetQuietMoves(const BoardState& board, MoveList& movesOut);
+
+	// Only generates moves of the piece at this position (if any)
+	void GetMovesFrom(const BoardState& board, Pos from, MoveList& movesOut);
 	void CountMoves(const BoardState& board, uint64_t& moveCount);
 }
\ No newline at end of file
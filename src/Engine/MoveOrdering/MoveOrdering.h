@@ -2,6 +2,22 @@
 #include "../BoardState/BoardState.h"
 
 namespace MoveOrdering {
-	// NOTE: Better moves will be placed towards end of the list
-	void SortMoves(MoveList& moves);
-}
\ No newline at end of file
+	// Selection step: swaps the best rated move in [index, size) into index and returns it
+	// Calling this for index 0, 1, 2... hands out rated moves best first,
+	//	so a node that cuts off early only pays for the moves it actually searched
+	FINLINE Move& PickNext(MoveList& moves, size_t index) {
+		size_t bestIndex = index;
+		int16_t bestRating = moves.data[index].moveRating;
+		for (size_t i = index + 1; i < moves.size; i++) {
+			if (moves.data[i].moveRating > bestRating) {
+				bestRating = moves.data[i].moveRating;
+				bestIndex = i;
+			}
+		}
+
+		if (bestIndex != index)
+			std::swap(moves.data[index], moves.data[bestIndex]);
+
+		return moves[index];
+	}
+}
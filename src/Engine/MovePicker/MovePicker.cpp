@@ -0,0 +1,155 @@
+#include "MovePicker.h"
+
+#include "../MoveGen/MoveGen.h"
+#include "../MoveOrdering/MoveOrdering.h"
+#include "../SEE/SEE.h"
+
+FINLINE bool IsNoisy(const Move& move) {
+	return move.flags & (Move::FL_CAPTURE | Move::FL_PROMOTION);
+}
+
+MovePicker::MovePicker(BoardState& boardState, MoveList& moves, MoveList& badCaptures, const MoveRating::HistoryContext& history, uint16_t ttMove, const uint16_t* killers) :
+	boardState(boardState), moves(moves), badCaptures(badCaptures), history(history), ttMove(ttMove) {
+
+	for (int i = 0; i < KILLER_MOVE_AMOUNT; i++)
+		this->killers[i] = killers[i];
+}
+
+bool MovePicker::FindLegalMove(uint16_t packedMove, Move& moveOut) {
+	// NOTE: Only called when the current stage's moves are no longer needed
+	moves.Clear();
+	MoveGen::GetMovesFrom(boardState, packedMove & (BD_SQUARE_AMOUNT - 1), moves);
+	for (Move& move : moves) {
+		if (move.Pack() == packedMove) {
+			moveOut = move;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void MovePicker::StartStage() {
+	switch (stage) {
+	case PICK_STAGE_GOOD_CAPTURES:
+	{
+		moves.Clear();
+		badCaptures.Clear();
+		MoveGen::GetNoisyMoves(boardState, moves);
+
+		// Move captures that lose material to their own list, and remove the TT move (already returned)
+		size_t goodCount = 0;
+		for (Move& move : moves) {
+			if (move.Pack() == ttMove)
+				continue;
+
+			Value seeValue = SEE::Evaluate(boardState, move);
+			if (seeValue >= 0) {
+				moves.data[goodCount++] = move;
+			} else {
+				// Rated by how much they lose, which the search also uses as their expected gain
+				move.moveRating = seeValue;
+				badCaptures.Add(move);
+			}
+		}
+		moves.size = goodCount;
+
+		MoveRating::RateCaptures(boardState, moves);
+		curIndex = 0;
+		break;
+	}
+	case PICK_STAGE_QUIETS:
+	{
+		moves.Clear();
+		MoveGen::GetQuietMoves(boardState, moves);
+
+		// Remove moves we already returned
+		size_t newCount = 0;
+		for (Move& move : moves) {
+			uint16_t packedMove = move.Pack();
+			if (packedMove != ttMove && !IsKiller(packedMove))
+				moves.data[newCount++] = move;
+		}
+		moves.size = newCount;
+
+		MoveRating::RateMoves(boardState, moves, history);
+		curIndex = 0;
+		quietCount = moves.size;
+		break;
+	}
+	case PICK_STAGE_BAD_CAPTURES:
+		// NOTE: Already rated by their SEE value when split from the good captures
+		curIndex = 0;
+		break;
+	default:
+		curIndex = 0;
+	}
+}
+
+bool MovePicker::NextInStage(Move& moveOut) {
+	// NOTE: Rated lists are never fully sorted, we just select the best remaining move each time
+	switch (stage) {
+	case PICK_STAGE_TT_MOVE:
+		if (curIndex > 0 || !ttMove)
+			return false;
+
+		curIndex++;
+		if (FindLegalMove(ttMove, moveOut))
+			return true;
+
+		ttMoveInvalid = true;
+		ttMove = 0;
+		return false;
+	case PICK_STAGE_GOOD_CAPTURES:
+	case PICK_STAGE_QUIETS:
+		if (curIndex >= moves.size)
+			return false;
+
+		moveOut = MoveOrdering::PickNext(moves, curIndex++);
+		return true;
+	case PICK_STAGE_KILLERS:
+		while (curIndex < KILLER_MOVE_AMOUNT) {
+			uint16_t killer = killers[curIndex++];
+			if (!killer || killer == ttMove)
+				continue;
+
+			// Killers come from other positions, so they need to be legal and quiet here
+			if (FindLegalMove(killer, moveOut) && !IsNoisy(moveOut))
+				return true;
+		}
+		return false;
+	case PICK_STAGE_BAD_CAPTURES:
+		if (curIndex >= badCaptures.size)
+			return false;
+
+		moveOut = MoveOrdering::PickNext(badCaptures, curIndex++);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool MovePicker::Next(Move& moveOut) {
+	while (stage != PICK_STAGE_DONE) {
+		if (!stageStarted) {
+			StartStage();
+			stageStarted = true;
+		}
+
+		if (NextInStage(moveOut))
+			return true;
+
+		stage++;
+		stageStarted = false;
+	}
+
+	return false;
+}
+
+bool MovePicker::IsLateMove() const {
+	if (stage == PICK_STAGE_QUIETS) {
+		return curIndex > (quietCount - quietCount / 4);
+	} else {
+		return stage == PICK_STAGE_BAD_CAPTURES;
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "../BoardState/BoardState.h"
+#include "../MoveRating/MoveRating.h"
+
+// Stages that a MovePicker goes through, in order
+enum {
+	PICK_STAGE_TT_MOVE,
+	PICK_STAGE_GOOD_CAPTURES, // Noisy moves that don't lose material
+	PICK_STAGE_KILLERS,
+	PICK_STAGE_QUIETS,
+	PICK_STAGE_BAD_CAPTURES, // Noisy moves that lose material, rated by their SEE value
+	PICK_STAGE_DONE
+};
+
+// Number of killer moves kept per ply
+#define KILLER_MOVE_AMOUNT 2
+
+// Hands out a position's moves one at a time, best first
+// Each stage's moves are only generated and rated once the previous stage runs out,
+//	so a node that cuts off on the TT move or a capture never generates its quiet moves
+struct MovePicker {
+	BoardState& boardState;
+
+	// NOTE: Storage is owned by the caller (a search frame), as these lists are too big for the stack
+	MoveList& moves;
+	MoveList& badCaptures;
+
+	MoveRating::HistoryContext history;
+
+	// Packed moves (see Move::Pack()) to try before generating anything, 0 if none
+	uint16_t ttMove;
+	uint16_t killers[KILLER_MOVE_AMOUNT];
+
+	// Stage of the move last returned by Next()
+	uint8_t stage = PICK_STAGE_TT_MOVE;
+
+	// Set if we were given a TT move that isn't legal here (hash collision)
+	bool ttMoveInvalid = false;
+
+	bool stageStarted = false;
+
+	// Position within the current stage
+	size_t curIndex = 0;
+
+	// Amount of quiet moves generated
+	size_t quietCount = 0;
+
+	MovePicker(BoardState& boardState, MoveList& moves, MoveList& badCaptures, const MoveRating::HistoryContext& history, uint16_t ttMove, const uint16_t* killers);
+
+	// Returns false once every legal move has been returned
+	bool Next(Move& moveOut);
+
+	// Is the move last returned by Next() one of the worst ordered moves?
+	// (A quiet move in the last quarter of the quiet moves, or a bad capture)
+	bool IsLateMove() const;
+
+	// Finds the legal move matching a packed move, returns false if there is none
+	// NOTE: Overwrites the moves list
+	bool FindLegalMove(uint16_t packedMove, Move& moveOut);
+
+	// Generates and orders the current stage's moves
+	void StartStage();
+
+	// Returns false once the current stage has run out of moves
+	bool NextInStage(Move& moveOut);
+
+	FINLINE bool IsKiller(uint16_t packedMove) const {
+		for (uint16_t killer : killers)
+			if (killer == packedMove)
+				return true;
+		return false;
+	}
+};
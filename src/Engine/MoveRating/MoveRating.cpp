@@ -1,12 +1,14 @@
 #include "MoveRating.h"
 
 #include "../LookupGen/LookupGen.h"
+#include "../SEE/SEE.h"
 
-void MoveRating::RateMoves(BoardState& boardState, MoveList& moves, ButterflyBoard& butterflyBoard) {
+void MoveRating::RateMoves(BoardState& boardState, MoveList& moves, const HistoryContext& history) {
 
 	constexpr Value
 		CAPTURE_BASE_BONUS = 100,
-		PROMOTION_QUEEN_BASE_BONUS = 1000;
+		PROMOTION_QUEEN_BASE_BONUS = 1000,
+		COUNTER_MOVE_BONUS = 100;
 
 	uint8_t team = boardState.turnTeam;
 	auto& td = boardState.teamData[team];
@@ -29,27 +31,24 @@ void MoveRating::RateMoves(BoardState& boardState, MoveList& moves, ButterflyBoa
 			isNormalCapture = etd.occupy[move.to],
 			fromAttacked	= etd.attack[move.from],
 			toAttacked		= etd.attack[move.to],
-			fromDefended	= td.attack[move.from],
-			toDefended		= td.attack[move.to];
+			fromDefended	= td.attack[move.from];
 
-		// If normal capture, add captured piece value to rating
-		if (isNormalCapture) {
-			rating += boardState.pieceValues[move.to];
+		if (toAttacked) {
+			// The enemy can fight over the destination, add whatever material we end up winning or losing there
+			rating += SEE::Evaluate(boardState, move);
+		} else if (isNormalCapture) {
+			// Free capture, add captured piece value to rating
+			rating += LookupGen::GetPieceSquareValue(boardState.GetPieceTypeAt(move.to, !team), move.to, !team, isEndgame);
 		}
 
 		// Prioritize the evasion of captures
 		if (fromAttacked) {
-			Value evasionValue = boardState.pieceValues[move.from];
+			Value evasionValue = LookupGen::GetPieceSquareValue(move.originalPiece, move.from, team, isEndgame);
 			if (fromDefended)
 				evasionValue /= 2; // We are defended, so moving is less important
 			rating += evasionValue;
 		}
 
-		// If we move to a square the enemy attacks, this piece will probably be lost
-		if (toAttacked) {
-			rating -= boardState.pieceValues[move.from];
-		}
-
 		{ // Add improvement of piece-square value to rating
 			Value
 				fromSquareValue = LookupGen::GetPieceSquareValue(move.originalPiece, move.from, !team, isEndgame),
@@ -58,9 +57,37 @@ void MoveRating::RateMoves(BoardState& boardState, MoveList& moves, ButterflyBoa
 			rating += toSquareValue - fromSquareValue;
 		}
 
-		// Add butterfly bonus
-		rating += butterflyBoard.data[team][move.from][move.to];
+		{ // Add history bonuses, scaled down to roughly match the other bonuses
+			int historyTotal = history.butterflyBoard->data[team][move.from][move.to];
+			for (ContHistory::Entry* contHistory : history.contHistories)
+				if (contHistory)
+					historyTotal += ContHistory::GetValue(*contHistory, move.resultPiece, move.to, team);
+
+			rating += historyTotal / 64;
+
+			if (move.Pack() == history.counterMove)
+				rating += COUNTER_MOVE_BONUS;
+		}
 
 		move.moveRating = CLAMP(rating, INT16_MIN, INT16_MAX);
 	}
+}
+
+void MoveRating::RateCaptures(const BoardState& boardState, MoveList& moves) {
+	constexpr int16_t PIECE_ORDER_VALUES[PT_AMOUNT] = { 1, 5, 3, 3, 9, 10 };
+
+	uint8_t team = boardState.turnTeam;
+	auto& etd = boardState.teamData[!team];
+
+	for (Move& move : moves) {
+		int16_t victimValue = 0;
+		if (etd.occupy[move.to]) {
+			victimValue = PIECE_ORDER_VALUES[boardState.GetPieceTypeAt(move.to, !team)];
+		} else if (move.flags & Move::FL_CAPTURE) {
+			victimValue = PIECE_ORDER_VALUES[PT_PAWN]; // En passant
+		}
+
+		int16_t promotionValue = PIECE_ORDER_VALUES[move.resultPiece] - PIECE_ORDER_VALUES[move.originalPiece];
+		move.moveRating = (victimValue + promotionValue) * 16 - PIECE_ORDER_VALUES[move.originalPiece];
+	}
 }
\ No newline at end of file
@@ -1,7 +1,23 @@
 #pragma once
 #include "../BoardState/BoardState.h"
 #include "../ButterflyBoard/ButterflyBoard.h"
+#include "../ContHistory/ContHistory.h"
 
 namespace MoveRating {
-	void RateMoves(BoardState& boardState, MoveList& moves, ButterflyBoard& butterflyBoard);
+	// What the search has learned about quiet moves, as seen from the position being rated
+	struct HistoryContext {
+		ButterflyBoard* butterflyBoard;
+
+		// Continuation history following the last move (index 0) and the move before it (index 1)
+		// NULL if there was no such move
+		ContHistory::Entry* contHistories[2];
+
+		// Packed move that last refuted the opponent's last move, 0 if none
+		uint16_t counterMove;
+	};
+
+	void RateMoves(BoardState& boardState, MoveList& moves, const HistoryContext& history);
+
+	// Cheaper rating for noisy moves only: most valuable victim first, then least valuable attacker
+	void RateCaptures(const BoardState& boardState, MoveList& moves);
 }
\ No newline at end of file
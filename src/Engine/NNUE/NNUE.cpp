@@ -0,0 +1,417 @@
+#include "NNUE.h"
+
+// Version number at the start of every HalfKP .nnue file
+#define NNUE_FILE_VERSION 0x7AF32F16
+
+// Hidden layer sums are scaled down by 2^NNUE_WEIGHT_SCALE_BITS before being clipped
+#define NNUE_WEIGHT_SCALE_BITS 6
+
+// The network's output is in 1/16ths of Stockfish's internal units, where a pawn is worth 208
+#define NNUE_OUTPUT_DIVISOR 16
+#define NNUE_OUTPUT_PAWN_VALUE 208
+
+// Clipped ReLU outputs are within [0, NNUE_CLIP_MAX]
+#define NNUE_CLIP_MAX 127
+
+// Feature index offset of each piece type, for a piece on [our team, the enemy team] from a perspective
+constexpr uint16_t PIECE_FEATURE_OFFSETS[PT_AMOUNT][TEAM_AMOUNT] = {
+	{ 1 + 0 * BD_SQUARE_AMOUNT, 1 + 1 * BD_SQUARE_AMOUNT }, // Pawn
+	{ 1 + 6 * BD_SQUARE_AMOUNT, 1 + 7 * BD_SQUARE_AMOUNT }, // Rook
+	{ 1 + 2 * BD_SQUARE_AMOUNT, 1 + 3 * BD_SQUARE_AMOUNT }, // Knight
+	{ 1 + 4 * BD_SQUARE_AMOUNT, 1 + 5 * BD_SQUARE_AMOUNT }, // Bishop
+	{ 1 + 8 * BD_SQUARE_AMOUNT, 1 + 9 * BD_SQUARE_AMOUNT }, // Queen
+	{ 0, 0 } // King (kings are not features)
+};
+
+template <size_t IN_DIMS, size_t OUT_DIMS>
+struct AffineLayer {
+	alignas(64) int32_t biases[OUT_DIMS];
+	alignas(64) int8_t weights[OUT_DIMS][IN_DIMS];
+};
+
+struct Network {
+	alignas(64) int16_t featureBiases[NNUE_HALF_DIMS];
+
+	// Indexed by [feature][NNUE_HALF_DIMS]
+	// NOTE: Heap allocated, as it is about 20MB
+	int16_t* featureWeights = NULL;
+
+	AffineLayer<NNUE_HALF_DIMS * 2, NNUE_HIDDEN_DIMS> hidden1;
+	AffineLayer<NNUE_HIDDEN_DIMS, NNUE_HIDDEN_DIMS> hidden2;
+	AffineLayer<NNUE_HIDDEN_DIMS, 1> output;
+};
+
+constexpr size_t FEATURE_WEIGHTS_SIZE = (size_t)NNUE_INPUT_DIMS * NNUE_HALF_DIMS * sizeof(int16_t);
+
+Network* g_Network = NULL;
+
+int16_t* AllocFeatureWeights() {
+#if defined(_MSC_VER)
+	return (int16_t*)_aligned_malloc(FEATURE_WEIGHTS_SIZE, 64);
+#else
+	// NOTE: FEATURE_WEIGHTS_SIZE is already a multiple of 64, as aligned_alloc() requires
+	return (int16_t*)aligned_alloc(64, FEATURE_WEIGHTS_SIZE);
+#endif
+}
+
+void FreeNetwork(Network* network) {
+	if (!network)
+		return;
+
+#if defined(_MSC_VER)
+	_aligned_free(network->featureWeights);
+#else
+	free(network->featureWeights);
+#endif
+	delete network;
+}
+
+// NOTE: Files are little-endian, as is every platform we build for
+template <typename T>
+FINLINE bool Read(std::istream& stream, T* out, size_t count = 1) {
+	stream.read((char*)out, sizeof(T) * count);
+	return (bool)stream;
+}
+
+template <size_t IN_DIMS, size_t OUT_DIMS>
+bool ReadLayer(std::istream& stream, AffineLayer<IN_DIMS, OUT_DIMS>& layer) {
+	return Read(stream, layer.biases, OUT_DIMS) && Read(stream, &layer.weights[0][0], OUT_DIMS * IN_DIMS);
+}
+
+// Returns NULL if the stream isn't a HalfKP network with exactly our layer sizes
+Network* ReadNetwork(std::istream& stream) {
+	uint32_t version, hash, descriptionSize;
+	if (!Read(stream, &version) || !Read(stream, &hash) || !Read(stream, &descriptionSize))
+		return NULL;
+
+	if (version != NNUE_FILE_VERSION)
+		return NULL;
+
+	stream.ignore(descriptionSize);
+
+	Network* network = new Network();
+	network->featureWeights = AllocFeatureWeights();
+	if (!network->featureWeights)
+		ERR_CLOSE("Failed to allocate " << (FEATURE_WEIGHTS_SIZE / (1024 * 1024)) << "MB for NNUE weights");
+
+	// NOTE: The hash before each part identifies its architecture, but any mismatch also shows up as the file being the wrong size
+	bool success =
+		Read(stream, &hash) &&
+		Read(stream, network->featureBiases, NNUE_HALF_DIMS) &&
+		Read(stream, network->featureWeights, (size_t)NNUE_INPUT_DIMS * NNUE_HALF_DIMS) &&
+		Read(stream, &hash) &&
+		ReadLayer(stream, network->hidden1) &&
+		ReadLayer(stream, network->hidden2) &&
+		ReadLayer(stream, network->output) &&
+		(stream.peek() == EOF);
+
+	if (!success) {
+		FreeNetwork(network);
+		return NULL;
+	}
+
+	return network;
+}
+
+bool NNUE::IsLoaded() {
+	return g_Network != NULL;
+}
+
+bool NNUE::LoadFile(const string& path) {
+	std::ifstream stream = std::ifstream(path, std::ios::binary);
+	if (!stream)
+		return false;
+
+	Network* network = ReadNetwork(stream);
+	if (!network)
+		return false;
+
+	FreeNetwork(g_Network);
+	g_Network = network;
+	return true;
+}
+
+#if defined(BM_NNUE_EMBED_FILE) && !defined(_MSC_VER)
+// Include the network file's bytes directly in the executable
+asm(
+	".section .rodata\n"
+	".balign 64\n"
+	".global bmEmbeddedNNUEBegin\n"
+	"bmEmbeddedNNUEBegin:\n"
+	".incbin \"" BM_NNUE_EMBED_FILE "\"\n"
+	".global bmEmbeddedNNUEEnd\n"
+	"bmEmbeddedNNUEEnd:\n"
+	".previous\n"
+);
+extern "C" const char bmEmbeddedNNUEBegin[], bmEmbeddedNNUEEnd[];
+#endif
+
+bool NNUE::LoadEmbedded() {
+#if defined(BM_NNUE_EMBED_FILE) && !defined(_MSC_VER)
+	std::istringstream stream = std::istringstream(string(bmEmbeddedNNUEBegin, bmEmbeddedNNUEEnd), std::ios::binary);
+	Network* network = ReadNetwork(stream);
+	if (!network)
+		return false;
+
+	FreeNetwork(g_Network);
+	g_Network = network;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void NNUE::Unload() {
+	FreeNetwork(g_Network);
+	g_Network = NULL;
+}
+
+void NNUE::OnMove(const BoardState& boardState, const Move& move, Accumulator& childAccumulator) {
+	childAccumulator.computed[TEAM_WHITE] = childAccumulator.computed[TEAM_BLACK] = false;
+	childAccumulator.isRoot = false;
+
+	uint8_t team = boardState.turnTeam;
+	uint8_t& count = childAccumulator.dirtyPieceCount;
+	count = 0;
+	auto fnAddDirtyPiece = [&](uint8_t pieceType, uint8_t pieceTeam, uint8_t from, uint8_t to) {
+		ASSERT(count < NNUE_MAX_DIRTY_PIECES);
+		childAccumulator.dirtyPieces[count++] = { pieceType, pieceTeam, from, to };
+	};
+
+	if (move.originalPiece == move.resultPiece) {
+		fnAddDirtyPiece(move.originalPiece, team, move.from, move.to);
+	} else {
+		// Promotion
+		fnAddDirtyPiece(move.originalPiece, team, move.from, NNUE_NO_SQUARE);
+		fnAddDirtyPiece(move.resultPiece, team, NNUE_NO_SQUARE, move.to);
+	}
+
+	if (boardState.teamData[!team].occupy[move.to]) {
+		fnAddDirtyPiece(boardState.GetPieceTypeAt(move.to, !team), !team, move.to, NNUE_NO_SQUARE);
+	} else if (move.originalPiece == PT_PAWN && move.to == boardState.enPassantToPos && boardState.enPassantToPos) {
+		fnAddDirtyPiece(PT_PAWN, !team, boardState.enPassantPawnPos, NNUE_NO_SQUARE);
+	} else if (move.originalPiece == PT_KING) {
+		int xDelta = move.to.X() - move.from.X();
+		if (xDelta && ((xDelta & 1) == 0)) {
+			// Castling, the rook moves too (see BoardState::ExecuteMove())
+			Pos rookFromPos = Pos((xDelta > 0 ? BD_SIZE - 1 : 0), move.from.Y());
+			Pos rookToPos = move.from.index + xDelta / 2;
+			fnAddDirtyPiece(PT_ROOK, team, rookFromPos, rookToPos);
+		}
+	}
+}
+
+FINLINE uint32_t GetFeatureIndex(uint8_t perspective, uint8_t kingPos, uint8_t pieceType, uint8_t team, uint8_t pos) {
+	// Black sees the board rotated, so that both perspectives see their own pieces from the bottom
+	uint8_t flip = (perspective == TEAM_WHITE) ? 0 : (BD_SQUARE_AMOUNT - 1);
+	return
+		(pos ^ flip) +
+		PIECE_FEATURE_OFFSETS[pieceType][team != perspective] +
+		NNUE_FEATURES_PER_KING_SQUARE * (kingPos ^ flip);
+}
+
+// Sets output to input, plus the weights of every added feature, minus the weights of every removed feature
+// NOTE: Output and input can be the same
+void ApplyFeatureChanges(
+	const int16_t* input, int16_t* output,
+	const uint32_t* added, size_t addedCount, const uint32_t* removed, size_t removedCount) {
+	const int16_t* weights = g_Network->featureWeights;
+
+#ifdef __AVX2__
+	// Keep a block of values in registers while all of the changes are applied to it
+	constexpr size_t VALUES_PER_REG = sizeof(__m256i) / sizeof(int16_t);
+	constexpr size_t BLOCK_REG_AMOUNT = 8;
+	constexpr size_t BLOCK_SIZE = VALUES_PER_REG * BLOCK_REG_AMOUNT;
+	SASSERT(NNUE_HALF_DIMS % BLOCK_SIZE == 0, "NNUE_HALF_DIMS must be a multiple of the AVX2 block size");
+
+	for (size_t blockStart = 0; blockStart < NNUE_HALF_DIMS; blockStart += BLOCK_SIZE) {
+		__m256i regs[BLOCK_REG_AMOUNT];
+		for (size_t i = 0; i < BLOCK_REG_AMOUNT; i++)
+			regs[i] = _mm256_load_si256((const __m256i*)(input + blockStart + i * VALUES_PER_REG));
+
+		for (size_t j = 0; j < addedCount; j++) {
+			const int16_t* column = weights + (size_t)added[j] * NNUE_HALF_DIMS + blockStart;
+			for (size_t i = 0; i < BLOCK_REG_AMOUNT; i++)
+				regs[i] = _mm256_add_epi16(regs[i], _mm256_load_si256((const __m256i*)(column + i * VALUES_PER_REG)));
+		}
+
+		for (size_t j = 0; j < removedCount; j++) {
+			const int16_t* column = weights + (size_t)removed[j] * NNUE_HALF_DIMS + blockStart;
+			for (size_t i = 0; i < BLOCK_REG_AMOUNT; i++)
+				regs[i] = _mm256_sub_epi16(regs[i], _mm256_load_si256((const __m256i*)(column + i * VALUES_PER_REG)));
+		}
+
+		for (size_t i = 0; i < BLOCK_REG_AMOUNT; i++)
+			_mm256_store_si256((__m256i*)(output + blockStart + i * VALUES_PER_REG), regs[i]);
+	}
+#else
+	if (output != input)
+		std::copy(input, input + NNUE_HALF_DIMS, output);
+
+	for (size_t j = 0; j < addedCount; j++) {
+		const int16_t* column = weights + (size_t)added[j] * NNUE_HALF_DIMS;
+		for (size_t i = 0; i < NNUE_HALF_DIMS; i++)
+			output[i] += column[i];
+	}
+
+	for (size_t j = 0; j < removedCount; j++) {
+		const int16_t* column = weights + (size_t)removed[j] * NNUE_HALF_DIMS;
+		for (size_t i = 0; i < NNUE_HALF_DIMS; i++)
+			output[i] -= column[i];
+	}
+#endif
+}
+
+// Computes a perspective of an accumulator from scratch
+void RefreshAccumulator(const BoardState& boardState, NNUE::Accumulator& accumulator, uint8_t perspective) {
+	uint8_t kingPos = boardState.teamData[perspective].kingPos;
+
+	// NOTE: At most 30 non-king pieces
+	uint32_t features[BD_SQUARE_AMOUNT];
+	size_t featureCount = 0;
+	for (uint8_t team = 0; team < TEAM_AMOUNT; team++) {
+		for (uint8_t pieceType = 0; pieceType < PT_KING; pieceType++) {
+			boardState.teamData[team].pieceSets[pieceType].Iterate(
+				[&](uint32_t pos) {
+					features[featureCount++] = GetFeatureIndex(perspective, kingPos, pieceType, team, pos);
+				}
+			);
+		}
+	}
+
+	ApplyFeatureChanges(g_Network->featureBiases, accumulator.values[perspective], features, featureCount, NULL, 0);
+	accumulator.computed[perspective] = true;
+}
+
+// Brings a perspective of an accumulator up to date
+// Applies the changes since the nearest computed accumulator below it, or refreshes if our king moved since then
+void UpdateAccumulator(const BoardState& boardState, NNUE::Accumulator* accumulator, uint8_t perspective) {
+	if (accumulator->computed[perspective])
+		return;
+
+	NNUE::Accumulator* cur = accumulator;
+	while (!cur->computed[perspective]) {
+		bool needsRefresh = cur->isRoot;
+		for (size_t i = 0; i < cur->dirtyPieceCount; i++) {
+			const NNUE::DirtyPiece& dirtyPiece = cur->dirtyPieces[i];
+			if (dirtyPiece.pieceType == PT_KING && dirtyPiece.team == perspective)
+				needsRefresh = true; // Every feature of this perspective depends on our king's position
+		}
+
+		if (needsRefresh) {
+			RefreshAccumulator(boardState, *accumulator, perspective);
+			return;
+		}
+
+		cur--;
+	}
+
+	// Our king hasn't moved since, so it's still where it is now
+	uint8_t kingPos = boardState.teamData[perspective].kingPos;
+
+	// Computing every accumulator on the way means their other children can be updated from them too
+	for (NNUE::Accumulator* next = cur + 1; next <= accumulator; next++) {
+		uint32_t added[NNUE_MAX_DIRTY_PIECES], removed[NNUE_MAX_DIRTY_PIECES];
+		size_t addedCount = 0, removedCount = 0;
+		for (size_t i = 0; i < next->dirtyPieceCount; i++) {
+			const NNUE::DirtyPiece& dirtyPiece = next->dirtyPieces[i];
+			if (dirtyPiece.pieceType == PT_KING)
+				continue;
+
+			if (dirtyPiece.from != NNUE_NO_SQUARE)
+				removed[removedCount++] = GetFeatureIndex(perspective, kingPos, dirtyPiece.pieceType, dirtyPiece.team, dirtyPiece.from);
+			if (dirtyPiece.to != NNUE_NO_SQUARE)
+				added[addedCount++] = GetFeatureIndex(perspective, kingPos, dirtyPiece.pieceType, dirtyPiece.team, dirtyPiece.to);
+		}
+
+		ApplyFeatureChanges(cur->values[perspective], next->values[perspective], added, addedCount, removed, removedCount);
+		next->computed[perspective] = true;
+		cur = next;
+	}
+}
+
+// Clips a perspective's accumulator values to [0, NNUE_CLIP_MAX]
+FINLINE void ClipAccumulator(const int16_t* values, uint8_t* output) {
+#ifdef __AVX2__
+	constexpr size_t VALUES_PER_REG = sizeof(__m256i) / sizeof(int16_t);
+	const __m256i zero = _mm256_setzero_si256();
+	for (size_t i = 0; i < NNUE_HALF_DIMS; i += VALUES_PER_REG * 2) {
+		__m256i
+			a = _mm256_load_si256((const __m256i*)(values + i)),
+			b = _mm256_load_si256((const __m256i*)(values + i + VALUES_PER_REG));
+
+		// Packing saturates to [-128, 127], but interleaves the 128-bit lanes of a and b, which the permute undoes
+		__m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), zero);
+		_mm256_store_si256((__m256i*)(output + i), _mm256_permute4x64_epi64(packed, 0b11011000));
+	}
+#else
+	for (size_t i = 0; i < NNUE_HALF_DIMS; i++)
+		output[i] = CLAMP(values[i], 0, NNUE_CLIP_MAX);
+#endif
+}
+
+// Dot product of clipped layer outputs and a row of weights
+// NOTE: Size must be a multiple of 32
+FINLINE int32_t DotProduct(const uint8_t* input, const int8_t* weights, size_t size) {
+#ifdef __AVX2__
+	__m256i sum = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	for (size_t i = 0; i < size; i += sizeof(__m256i)) {
+		// Inputs are at most NNUE_CLIP_MAX, so adjacent products can't saturate when summed into 16 bits
+		__m256i products = _mm256_maddubs_epi16(
+			_mm256_load_si256((const __m256i*)(input + i)), _mm256_load_si256((const __m256i*)(weights + i))
+		);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+	}
+
+	__m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0b01001110));
+	sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0b10110001));
+	return _mm_cvtsi128_si32(sum128);
+#else
+	int32_t sum = 0;
+	for (size_t i = 0; i < size; i++)
+		sum += (int32_t)input[i] * weights[i];
+	return sum;
+#endif
+}
+
+// Runs a hidden layer, followed by a clipped ReLU
+template <size_t IN_DIMS, size_t OUT_DIMS>
+FINLINE void PropagateHidden(const AffineLayer<IN_DIMS, OUT_DIMS>& layer, const uint8_t* input, uint8_t* output) {
+	SASSERT(IN_DIMS % 32 == 0, "Layer inputs must be a multiple of 32");
+	for (size_t i = 0; i < OUT_DIMS; i++) {
+		int32_t sum = layer.biases[i] + DotProduct(input, layer.weights[i], IN_DIMS);
+		output[i] = CLAMP(sum >> NNUE_WEIGHT_SCALE_BITS, 0, NNUE_CLIP_MAX);
+	}
+}
+
+Value NNUE::Evaluate(const BoardState& boardState, Accumulator* accumulator) {
+	ASSERT(IsLoaded());
+
+	UpdateAccumulator(boardState, accumulator, TEAM_WHITE);
+	UpdateAccumulator(boardState, accumulator, TEAM_BLACK);
+
+#ifdef _DEBUG
+	// Incremental updates must always give the same values as computing from scratch
+	for (uint8_t perspective = 0; perspective < TEAM_AMOUNT; perspective++) {
+		Accumulator refreshed;
+		RefreshAccumulator(boardState, refreshed, perspective);
+		if (memcmp(refreshed.values[perspective], accumulator->values[perspective], sizeof(refreshed.values[perspective])))
+			ERR_CLOSE("NNUE accumulator for " << TEAM_NAMES[perspective] << " doesn't match its refreshed values on BoardState " << boardState);
+	}
+#endif
+
+	uint8_t team = boardState.turnTeam;
+
+	alignas(32) uint8_t featureOutput[NNUE_HALF_DIMS * 2];
+	ClipAccumulator(accumulator->values[team], featureOutput);
+	ClipAccumulator(accumulator->values[!team], featureOutput + NNUE_HALF_DIMS);
+
+	alignas(32) uint8_t hidden1Output[NNUE_HIDDEN_DIMS], hidden2Output[NNUE_HIDDEN_DIMS];
+	PropagateHidden(g_Network->hidden1, featureOutput, hidden1Output);
+	PropagateHidden(g_Network->hidden2, hidden1Output, hidden2Output);
+
+	int32_t output = g_Network->output.biases[0] + DotProduct(hidden2Output, g_Network->output.weights[0], NNUE_HIDDEN_DIMS);
+	return (Value)output * 100 / (NNUE_OUTPUT_DIVISOR * NNUE_OUTPUT_PAWN_VALUE);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "../BoardState/BoardState.h"
+
+// Efficiently updatable neural network evaluation (NNUE)
+// Uses the "HalfKP" architecture, and reads the original Stockfish ".nnue" file format for it:
+//	Each perspective has a feature for every (own king square, non-king piece, piece square), which are transformed into 256 values
+//	The two halves (side to move first) are then fed through 512 -> 32 -> 32 -> 1, with clipped ReLU between layers
+// The first layer is the only expensive one, so its output (the "accumulator") is updated incrementally as moves are made
+// NOTE: Only used if a network has been loaded, otherwise search uses the hand-crafted eval
+
+// Features per king square: 10 non-king piece types (5 per team) on 64 squares, plus one unused feature
+#define NNUE_FEATURES_PER_KING_SQUARE (10 * BD_SQUARE_AMOUNT + 1)
+#define NNUE_INPUT_DIMS (NNUE_FEATURES_PER_KING_SQUARE * BD_SQUARE_AMOUNT)
+
+// Size of a single perspective's accumulator
+#define NNUE_HALF_DIMS 256
+
+#define NNUE_HIDDEN_DIMS 32
+
+// Most pieces a single move can change (promoting by capturing: the pawn, the captured piece, and the promoted piece)
+#define NNUE_MAX_DIRTY_PIECES 3
+
+// Used as the from or to square of a dirty piece that was added or removed
+#define NNUE_NO_SQUARE BD_SQUARE_AMOUNT
+
+namespace NNUE {
+	// A piece that was moved, added or removed by a move
+	struct DirtyPiece {
+		uint8_t pieceType, team;
+		uint8_t from, to; // NNUE_NO_SQUARE if the piece was added or removed
+	};
+
+	// First layer output of a position, for both perspectives
+	// Accumulators are kept in a stack (one per ply), each recording what changed since the one before it,
+	//	so that values are only computed for positions that actually get evaluated, from the nearest one that was
+	struct Accumulator {
+		alignas(32) int16_t values[TEAM_AMOUNT][NNUE_HALF_DIMS];
+
+		// Are the values of each perspective up to date?
+		bool computed[TEAM_AMOUNT];
+
+		// If set, this is the bottom of the stack, so its values can only be computed from scratch
+		bool isRoot;
+
+		// What changed since the previous accumulator in the stack
+		DirtyPiece dirtyPieces[NNUE_MAX_DIRTY_PIECES];
+		uint8_t dirtyPieceCount;
+	};
+
+	// Returns true if a network is loaded and can be used by Evaluate()
+	bool IsLoaded();
+
+	// Loads a network from a .nnue file
+	// Returns false if the file couldn't be read or has a different architecture, in which case the current network is kept
+	bool LoadFile(const string& path);
+
+	// Loads the network embedded at build time (see BM_NNUE_EMBED_FILE in CMakeLists.txt)
+	// Returns false if there isn't one
+	bool LoadEmbedded();
+
+	// Go back to using the hand-crafted eval
+	void Unload();
+
+	// Starts a new stack at this accumulator, its values will be computed from scratch
+	FINLINE void ResetAccumulator(Accumulator& accumulator) {
+		accumulator.computed[TEAM_WHITE] = accumulator.computed[TEAM_BLACK] = false;
+		accumulator.isRoot = true;
+		accumulator.dirtyPieceCount = 0;
+	}
+
+	// Records what a move changes into the accumulator after it in the stack
+	// NOTE: Must be called with the board from before the move is executed
+	void OnMove(const BoardState& boardState, const Move& move, Accumulator& childAccumulator);
+
+	// Same as OnMove(), for a null move (nothing changes)
+	FINLINE void OnNullMove(Accumulator& childAccumulator) {
+		childAccumulator.computed[TEAM_WHITE] = childAccumulator.computed[TEAM_BLACK] = false;
+		childAccumulator.isRoot = false;
+		childAccumulator.dirtyPieceCount = 0;
+	}
+
+	// Evaluates a position in centipawns, relative to who's turn it is
+	// NOTE: The accumulator must be the top of a stack of accumulators that are contiguous in memory,
+	//	and boardState must be the position it is for
+	Value Evaluate(const BoardState& boardState, Accumulator* accumulator);
+}
@@ -0,0 +1,33 @@
+#include "PerftCache.h"
+
+void PerftCacheTable::Init(size_t sizeMB) {
+	size_t newBucketCount = 0;
+	if (sizeMB > 0) {
+		// Round the bucket count down to a power of two, so that we can mask instead of modulo
+		size_t maxBucketCount = sizeMB * 1024 * 1024 / sizeof(PerftCacheBucket);
+		newBucketCount = 1;
+		while (newBucketCount * 2 <= maxBucketCount)
+			newBucketCount *= 2;
+	}
+
+	if (newBucketCount != bucketCount) {
+		if (newBucketCount > 0) {
+			buckets = std::make_unique<PerftCacheBucket[]>(newBucketCount);
+		} else {
+			buckets = NULL;
+		}
+
+		bucketCount = newBucketCount;
+		bucketMask = (newBucketCount > 0) ? (newBucketCount - 1) : 0;
+	}
+
+	Reset();
+}
+
+void PerftCacheTable::Reset() {
+	for (size_t i = 0; i < bucketCount; i++)
+		new (&buckets[i]) PerftCacheBucket();
+}
+
+PerftCacheTable
+PerftCache::main = {};
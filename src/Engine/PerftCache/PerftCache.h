@@ -0,0 +1,97 @@
+#pragma once
+#include "../Zobrist/Zobrist.h"
+
+// Cache of perft subtree node counts, so that transposed subtrees don't need to be counted again
+// NOTE: Entirely separate from the transposition table, so that perft doesn't trash search results (and vice versa)
+
+// Number of bits of the data word used for the node count, the rest is used for the depth
+#define PERFT_CACHE_COUNT_BITS 56
+#define PERFT_CACHE_COUNT_MASK ((1ull << PERFT_CACHE_COUNT_BITS) - 1)
+
+// Default size of the cache, in megabytes
+// NOTE: 0 means the cache is disabled
+#define PERFT_CACHE_DEFAULT_SIZE_MB 0
+#define PERFT_CACHE_MAX_SIZE_MB (1024 * 1024)
+
+// A single lockless entry, see TransposEntry
+// The full hash is verified, as a false match would silently corrupt the final count
+struct PerftCacheEntry {
+	std::atomic<uint64_t> hashXorData, data;
+
+	PerftCacheEntry() : hashXorData(0), data(0) {}
+
+	FINLINE static uint64_t PackData(uint16_t depth, uint64_t count) {
+		return ((uint64_t)depth << PERFT_CACHE_COUNT_BITS) | count;
+	}
+
+	FINLINE uint16_t GetDepth() const {
+		return (uint16_t)(data.load(std::memory_order_relaxed) >> PERFT_CACHE_COUNT_BITS);
+	}
+
+	// Returns false if this entry isn't for this hash and depth
+	FINLINE bool Load(ZobristHash hash, uint16_t depth, uint64_t& countOut) const {
+		uint64_t curData = data.load(std::memory_order_relaxed);
+		uint64_t curHashXorData = hashXorData.load(std::memory_order_relaxed);
+		if ((curHashXorData ^ curData) != hash || (curData >> PERFT_CACHE_COUNT_BITS) != depth)
+			return false;
+
+		countOut = curData & PERFT_CACHE_COUNT_MASK;
+		return true;
+	}
+
+	FINLINE void Store(ZobristHash hash, uint16_t depth, uint64_t count) {
+		uint64_t packedData = PackData(depth, count);
+		data.store(packedData, std::memory_order_relaxed);
+		hashXorData.store(hash ^ packedData, std::memory_order_relaxed);
+	}
+};
+
+// Slot 0 is only replaced by deeper (more valuable) counts, slot 1 is always replaced
+struct alignas(32) PerftCacheBucket {
+	PerftCacheEntry depthPreferred, alwaysReplace;
+};
+
+struct PerftCacheTable {
+	std::unique_ptr<PerftCacheBucket[]> buckets;
+
+	// NOTE: Always a power of two, or 0 if disabled
+	size_t bucketCount = 0;
+	size_t bucketMask = 0;
+
+	// (Re)allocates the cache to the largest power-of-two bucket count that fits within sizeMB, and clears it
+	// A size of 0 disables the cache
+	// NOTE: Must not be called during a perft search
+	void Init(size_t sizeMB);
+	void Reset();
+
+	FINLINE bool IsEnabled() const {
+		return bucketCount > 0;
+	}
+
+	FINLINE PerftCacheBucket& GetBucket(ZobristHash hash, uint16_t depth) {
+		// Mix in the depth so that the same position at different depths won't fight over a bucket
+		return buckets[(hash ^ (depth * 0x9E3779B97F4A7C15ull)) & bucketMask];
+	}
+
+	FINLINE bool Find(ZobristHash hash, uint16_t depth, uint64_t& countOut) {
+		PerftCacheBucket& bucket = GetBucket(hash, depth);
+		return bucket.depthPreferred.Load(hash, depth, countOut) || bucket.alwaysReplace.Load(hash, depth, countOut);
+	}
+
+	FINLINE void Store(ZobristHash hash, uint16_t depth, uint64_t count) {
+		// Counts this big can't be stored
+		if (count > PERFT_CACHE_COUNT_MASK)
+			return;
+
+		PerftCacheBucket& bucket = GetBucket(hash, depth);
+		if (depth >= bucket.depthPreferred.GetDepth()) {
+			bucket.depthPreferred.Store(hash, depth, count);
+		} else {
+			bucket.alwaysReplace.Store(hash, depth, count);
+		}
+	}
+};
+
+namespace PerftCache {
+	extern PerftCacheTable main;
+}
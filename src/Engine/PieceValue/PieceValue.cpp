@@ -12,15 +12,6 @@ Value PieceValue::CalcPieceSquareValue(uint8_t pieceType, uint8_t team, Pos pos,
 	uint8_t
 		mirrorX = x < 4 ? x : (BD_SIZE - x - 1);
 
-	constexpr Value PIECE_BASE_VALUES[PT_AMOUNT] = {
-		100, // Pawn
-		550, // Rook
-		310, // Knight
-		330, // Bishop
-		950, // Queen
-		0 // King
-	};
-
 	// Bonus for each square for a given piece
 	// Last dimension is if this is an endgame or not
 	// From https://www.chessprogramming.org/Simplified_Evaluation_Function
@@ -182,5 +173,5 @@ Value PieceValue::CalcPieceSquareValue(uint8_t pieceType, uint8_t team, Pos pos,
 	constexpr float BONUS_SCALE = 0.9f;
 
 	int mirrorIndex = mirrorX + ((7 - y) * BD_SIZE / 2);
-	return PIECE_BASE_VALUES[pieceType] + (PIECE_BONUS[pieceType][isEndGame][mirrorIndex] * BONUS_SCALE);
+	return BASE_VALUES[pieceType] + (PIECE_BONUS[pieceType][isEndGame][mirrorIndex] * BONUS_SCALE);
 }
\ No newline at end of file
@@ -12,6 +12,16 @@ typedef int64_t Value;
 namespace PieceValue {
 	Value CalcPieceSquareValue(uint8_t pieceType, uint8_t team, Pos pos, bool isEndGame);
 
+	// Value of each piece, regardless of where it is
+	constexpr Value BASE_VALUES[PT_AMOUNT] = {
+		100, // Pawn
+		550, // Rook
+		310, // Knight
+		330, // Bishop
+		950, // Queen
+		0 // King
+	};
+
 	// Value added for each move available to a given piece
 	constexpr Value MOBILITY_BONUS[PT_AMOUNT] = {
 		// Pawn
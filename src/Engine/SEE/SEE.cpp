@@ -0,0 +1,123 @@
+#include "SEE.h"
+
+#include "../LookupGen/LookupGen.h"
+
+// The king is never actually captured, this just needs to be more than everything else combined
+constexpr Value SEE_KING_VALUE = 20 * 1000;
+
+FINLINE Value GetSEEValue(uint8_t pieceType) {
+	return (pieceType == PT_KING) ? SEE_KING_VALUE : PieceValue::BASE_VALUES[pieceType];
+}
+
+// All pieces of both teams that attack a square, given what squares are occupied
+FINLINE BitBoard GetAttackersTo(const BoardState& boardState, Pos pos, BitBoard occupy, BitBoard diagonalSliders, BitBoard straightSliders) {
+	auto& wtd = boardState.teamData[TEAM_WHITE];
+	auto& btd = boardState.teamData[TEAM_BLACK];
+
+	BitBoard baseMoves, bishopMoves, rookMoves;
+	LookupGen::GetBishopMoves(pos, occupy, baseMoves, bishopMoves);
+	LookupGen::GetRookMoves(pos, occupy, baseMoves, rookMoves);
+
+	BitBoard attackers =
+		// A pawn attacks us if we would attack it, were we a pawn of the other team
+		(LookupGen::GetPawnAttacks(pos, TEAM_BLACK) & wtd.pieceSets[PT_PAWN]) |
+		(LookupGen::GetPawnAttacks(pos, TEAM_WHITE) & btd.pieceSets[PT_PAWN]) |
+		(LookupGen::GetKnightMoves(pos) & (wtd.pieceSets[PT_KNIGHT] | btd.pieceSets[PT_KNIGHT])) |
+		(LookupGen::GetKingMoves(pos) & (wtd.pieceSets[PT_KING] | btd.pieceSets[PT_KING])) |
+		(bishopMoves & diagonalSliders) |
+		(rookMoves & straightSliders);
+
+	return attackers & occupy;
+}
+
+Value SEE::Evaluate(const BoardState& boardState, const Move& move) {
+	// Order in which pieces are used to capture
+	constexpr uint8_t CAPTURE_ORDER[PT_AMOUNT] = { PT_PAWN, PT_KNIGHT, PT_BISHOP, PT_ROOK, PT_QUEEN, PT_KING };
+
+	// Enough for every piece on the board to capture once
+	constexpr size_t MAX_SWAPS = 32 + 1;
+
+	uint8_t team = boardState.turnTeam;
+	auto& etd = boardState.teamData[!team];
+
+	// Castling can never be captured
+	if (move.originalPiece == PT_KING && abs(move.to.X() - move.from.X()) == 2)
+		return 0;
+
+	BitBoard occupy = boardState.teamData[TEAM_WHITE].occupy | boardState.teamData[TEAM_BLACK].occupy;
+
+	// Gain of each successive capture, from the perspective of whoever made it
+	Value gains[MAX_SWAPS];
+
+	if (etd.occupy[move.to]) {
+		gains[0] = GetSEEValue(boardState.GetPieceTypeAt(move.to, !team));
+	} else if (move.originalPiece == PT_PAWN && move.to == boardState.enPassantToPos && boardState.enPassantToPos) {
+		gains[0] = GetSEEValue(PT_PAWN);
+		occupy.Set(boardState.enPassantPawnPos, false);
+	} else {
+		gains[0] = 0;
+	}
+
+	// Promotions gain the difference on the spot
+	gains[0] += GetSEEValue(move.resultPiece) - GetSEEValue(move.originalPiece);
+
+	occupy.Set(move.from, false);
+
+	BitBoard
+		diagonalSliders =
+			boardState.teamData[TEAM_WHITE].pieceSets[PT_BISHOP] | boardState.teamData[TEAM_WHITE].pieceSets[PT_QUEEN] |
+			boardState.teamData[TEAM_BLACK].pieceSets[PT_BISHOP] | boardState.teamData[TEAM_BLACK].pieceSets[PT_QUEEN],
+		straightSliders =
+			boardState.teamData[TEAM_WHITE].pieceSets[PT_ROOK] | boardState.teamData[TEAM_WHITE].pieceSets[PT_QUEEN] |
+			boardState.teamData[TEAM_BLACK].pieceSets[PT_ROOK] | boardState.teamData[TEAM_BLACK].pieceSets[PT_QUEEN];
+
+	BitBoard attackers = GetAttackersTo(boardState, move.to, occupy, diagonalSliders, straightSliders);
+
+	// The piece that is currently sitting on the square, and would be captured next
+	uint8_t pieceOnSquare = move.resultPiece;
+	uint8_t curTeam = !team;
+
+	size_t depth = 0;
+	while (true) {
+		BitBoard teamAttackers = attackers & boardState.teamData[curTeam].occupy;
+		if (!teamAttackers)
+			break;
+
+		// Find our least valuable attacker
+		uint8_t attackerType = PT_KING;
+		BitBoard attackerMask = 0;
+		for (uint8_t pieceType : CAPTURE_ORDER) {
+			BitBoard pieceAttackers = teamAttackers & boardState.teamData[curTeam].pieceSets[pieceType];
+			if (pieceAttackers) {
+				attackerType = pieceType;
+				attackerMask = pieceAttackers.data & (~pieceAttackers.data + 1); // Lowest bit
+				break;
+			}
+		}
+
+		depth++;
+		ASSERT(depth < MAX_SWAPS);
+		gains[depth] = GetSEEValue(pieceOnSquare) - gains[depth - 1];
+
+		// Remove the capturing piece, which can reveal sliding pieces behind it (x-rays)
+		occupy &= ~attackerMask;
+		{
+			BitBoard baseMoves, bishopMoves, rookMoves;
+			LookupGen::GetBishopMoves(move.to, occupy, baseMoves, bishopMoves);
+			LookupGen::GetRookMoves(move.to, occupy, baseMoves, rookMoves);
+			attackers |= (bishopMoves & diagonalSliders) | (rookMoves & straightSliders);
+		}
+		attackers &= occupy;
+
+		pieceOnSquare = attackerType;
+		curTeam = !curTeam;
+	}
+
+	// Each side can choose to stop capturing instead, resolve from the end of the sequence back to the start
+	while (depth > 0) {
+		gains[depth - 1] = -MAX(-gains[depth - 1], gains[depth]);
+		depth--;
+	}
+
+	return gains[0];
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "../BoardState/BoardState.h"
+
+// Static Exchange Evaluation
+// Resolves the sequence of captures on a move's destination square, with each side always recapturing with its least valuable piece
+//	(and being allowed to stop capturing whenever continuing would lose material)
+namespace SEE {
+	// Material we expect to gain from a move (for the team making it) once all captures on its destination are resolved
+	// NOTE: Works for non-captures too, in which case the result is 0 or the loss of the moved piece
+	Value Evaluate(const BoardState& boardState, const Move& move);
+
+	// Same as (Evaluate() >= threshold)
+	FINLINE bool IsAtLeast(const BoardState& boardState, const Move& move, Value threshold) {
+		return Evaluate(boardState, move) >= threshold;
+	}
+}
@@ -0,0 +1,103 @@
+#include "TimeManager.h"
+
+void TimeManager::ResetSearchState() {
+	startTimeMS = lastIterationStartMS = CUR_MS();
+	softLimitMS = baseSoftLimitMS;
+
+	lastBestMove = 0;
+	lastEval = 0;
+	bestMoveStability = 0;
+}
+
+void TimeManager::Start(const TimeControl& timeControl, uint8_t team) {
+	isLimited = timeControl.IsLimited();
+	isFixedTime = (timeControl.moveTime >= 0);
+
+	if (!isLimited) {
+		softLimitMS = hardLimitMS = baseSoftLimitMS = INT64_MAX;
+		ResetSearchState();
+		return;
+	}
+
+	if (isFixedTime) {
+		// We were told exactly how long to search, so don't try to be clever about it
+		softLimitMS = hardLimitMS = baseSoftLimitMS = MAX(timeControl.moveTime - TIME_MOVE_OVERHEAD_MS, 1);
+		ResetSearchState();
+		return;
+	}
+
+	int64_t
+		timeLeft = MAX(timeControl.timeLeft[team], 0),
+		increment = MAX(timeControl.increment[team], 0),
+		movesToGo = (timeControl.movesToGo > 0) ? timeControl.movesToGo : TIME_DEFAULT_MOVES_TO_GO;
+
+	int64_t usableTime = MAX(timeLeft - TIME_MOVE_OVERHEAD_MS, 1);
+
+	// Spread the clock evenly over the remaining moves, and use most of the increment as we get it back
+	baseSoftLimitMS = (usableTime / movesToGo) + (increment * 3 / 4);
+
+	// Never use a large chunk of the clock on one move, unless it is the last move before the time control
+	int64_t hardLimitScale = (movesToGo == 1) ? 8 : 3; // Out of 10
+	hardLimitMS = MIN(MAX(baseSoftLimitMS * 4, 1), usableTime * hardLimitScale / 10);
+	hardLimitMS = MAX(hardLimitMS, 1);
+
+	baseSoftLimitMS = MIN(baseSoftLimitMS, hardLimitMS);
+	ResetSearchState();
+}
+
+void TimeManager::Restart() {
+	ResetSearchState();
+}
+
+bool TimeManager::OnIterationComplete(uint16_t bestMove, Value eval) {
+	int64_t
+		curTimeMS = CUR_MS(),
+		elapsedMS = curTimeMS - startTimeMS,
+		iterationMS = curTimeMS - lastIterationStartMS;
+
+	bool isFirstIteration = (lastBestMove == 0);
+
+	if (bestMove == lastBestMove) {
+		bestMoveStability++;
+	} else {
+		bestMoveStability = 0;
+	}
+
+	if (isLimited && !isFirstIteration) {
+		// If the best move keeps changing, we aren't sure about it, so take more time
+		// If it has stayed the same for a while, more time probably won't change it
+		constexpr float STABILITY_SCALES[] = { 1.6f, 1.3f, 1.1f, 1.0f, 0.9f, 0.8f };
+		constexpr int MAX_STABILITY = sizeof(STABILITY_SCALES) / sizeof(float) - 1;
+		float scale = STABILITY_SCALES[MIN(bestMoveStability, MAX_STABILITY)];
+
+		// Spend more time if our eval just dropped, we might be able to find a way out
+		if (abs(eval) < CHECKMATE_VALUE && abs(lastEval) < CHECKMATE_VALUE) {
+			Value evalDrop = CLAMP(lastEval - eval, 0, 100);
+			scale *= 1 + (evalDrop / 100.f);
+		}
+
+		softLimitMS = MIN((int64_t)(baseSoftLimitMS * scale), hardLimitMS);
+	}
+
+	lastBestMove = bestMove;
+	lastEval = eval;
+	lastIterationStartMS = curTimeMS;
+
+	if (!isLimited)
+		return false;
+
+	if (elapsedMS >= softLimitMS)
+		return true;
+
+	// With a fixed time, we may as well use all of it, the search is interrupted once it runs out
+	if (isFixedTime)
+		return false;
+
+	// The next iteration will take a few times as long as this one (roughly our effective branching factor),
+	//	don't start it if it can't finish in time
+	constexpr int64_t NEXT_ITERATION_SCALE = 4;
+	if (elapsedMS + (iterationMS * NEXT_ITERATION_SCALE) >= hardLimitMS)
+		return true;
+
+	return false;
+}
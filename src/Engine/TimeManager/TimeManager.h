@@ -0,0 +1,78 @@
+#pragma once
+#include "../PieceValue/PieceValue.h"
+
+// Time assumed to be lost between the GUI sending "go" and receiving our move (communication, thread startup, etc.)
+#define TIME_MOVE_OVERHEAD_MS 30
+
+// Moves we assume are left to play when the GUI doesn't tell us (no "movestogo")
+#define TIME_DEFAULT_MOVES_TO_GO 30
+
+// Time control from the "go" command, all times are in milliseconds
+struct TimeControl {
+	// Remaining clock time of each team, -1 if not given
+	int64_t timeLeft[TEAM_AMOUNT] = { -1, -1 };
+
+	// Increment per move of each team
+	int64_t increment[TEAM_AMOUNT] = { 0, 0 };
+
+	// Moves until the next time control, 0 if not given
+	int64_t movesToGo = 0;
+
+	// Fixed time to spend on this move, -1 if not given
+	int64_t moveTime = -1;
+
+	// Returns false if we can search for as long as we want
+	bool IsLimited() const {
+		return moveTime >= 0 || timeLeft[TEAM_WHITE] >= 0 || timeLeft[TEAM_BLACK] >= 0;
+	}
+};
+
+// Turns a time control into time limits for a single search,
+//	then decides between iterations of iterative deepening whether another iteration is worth starting
+struct TimeManager {
+	bool isLimited;
+
+	// Were we given an exact time to search for ("movetime")?
+	bool isFixedTime;
+
+	// NOTE: Atomic as it can be restarted from another thread during a search
+	std::atomic<int64_t> startTimeMS;
+
+	// Time we would like to use, adjusted after each iteration
+	int64_t softLimitMS;
+
+	// Time we must never go past
+	int64_t hardLimitMS;
+
+	// Soft limit before any adjustments
+	int64_t baseSoftLimitMS;
+
+	// Info from the last completed iteration
+	uint16_t lastBestMove;
+	Value lastEval;
+	int64_t lastIterationStartMS;
+
+	// Number of consecutive iterations that agreed on the best move
+	uint16_t bestMoveStability;
+
+	void Start(const TimeControl& timeControl, uint8_t team);
+
+	// Starts counting from now again, keeping the same limits
+	// Used when pondering ends, as our clock was not running during it
+	void Restart();
+
+	// Starts the clock and forgets everything learned from previous iterations, shared by Start() and Restart()
+	void ResetSearchState();
+
+	FINLINE int64_t GetElapsedMS() const {
+		return CUR_MS() - startTimeMS;
+	}
+
+	FINLINE bool IsHardLimitReached() const {
+		return isLimited && GetElapsedMS() >= hardLimitMS;
+	}
+
+	// Called after every completed iteration with its best move (packed) and eval
+	// Returns true if we should stop, rather than starting another iteration
+	bool OnIterationComplete(uint16_t bestMove, Value eval);
+};
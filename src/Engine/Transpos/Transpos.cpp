@@ -1,46 +1,69 @@
 #include "Transpos.h"
 
-void TransposTable::Init(size_t newSize) {
-	buckets.resize(newSize);
-	Reset();
-}
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
-void TransposTable::Reset() {
-	for (TransposBucket& bucket : buckets)
-		bucket = TransposBucket();
-}
+// Alignment of the bucket memory
+// On Linux, this is the size of a transparent huge page
+#define TRANSPOS_MEMORY_ALIGNMENT (2 * TRANSPOS_BYTES_PER_MB)
 
-void TransposTable::MarkOld() {
-#ifdef _DEBUG
-	LOG("Marking old transpos table entries...");
+void* AllocBucketMemory(size_t size) {
+#if defined(_MSC_VER)
+	return _aligned_malloc(size, TRANSPOS_MEMORY_ALIGNMENT);
+#else
+	// NOTE: aligned_alloc() requires the size to be a multiple of the alignment
+	size_t alignedSize = ((size + TRANSPOS_MEMORY_ALIGNMENT - 1) / TRANSPOS_MEMORY_ALIGNMENT) * TRANSPOS_MEMORY_ALIGNMENT;
+	void* memory = aligned_alloc(TRANSPOS_MEMORY_ALIGNMENT, alignedSize);
 
-	size_t numDecreased = 0, numReset = 0;
+#ifdef __linux__
+	// Ask for the table to be backed by huge pages
+	// TT probes are random access across the entire table, so regular 4KB pages would mean a TLB miss on almost every probe
+	if (memory)
+		madvise(memory, alignedSize, MADV_HUGEPAGE);
 #endif
 
-	for (auto& bucket : buckets) {
-		for (auto& entry : bucket.entries) {
-			if (!entry.IsValid())
-				continue;
-
-			if (entry.depth > TRANSPOS_OLD_DEPTH_DECREASE) {
-				entry.depth -= TRANSPOS_OLD_DEPTH_DECREASE;
-#ifdef _DEBUG
-				numDecreased++;
+	return memory;
 #endif
-			} else {
-				// Depth is <= decrease, just reset it
-				entry.Reset();
-#ifdef _DEBUG
-				numReset++;
+}
+
+void FreeBucketMemory(void* memory) {
+#if defined(_MSC_VER)
+	_aligned_free(memory);
+#else
+	free(memory);
 #endif
-			}
-		}
+}
+
+void TransposTable::Init(size_t sizeMB) {
+	// Round the bucket count down to a power of two, so that we can mask instead of modulo
+	size_t maxBucketCount = MAX(sizeMB, 1) * TRANSPOS_BYTES_PER_MB / sizeof(TransposBucket);
+	size_t newBucketCount = 1;
+	while (newBucketCount * 2 <= maxBucketCount)
+		newBucketCount *= 2;
+
+	if (newBucketCount != bucketCount) {
+		if (buckets)
+			FreeBucketMemory(buckets);
+
+		buckets = (TransposBucket*)AllocBucketMemory(newBucketCount * sizeof(TransposBucket));
+		if (!buckets)
+			ERR_CLOSE("Failed to allocate " << sizeMB << "MB for the transposition table");
+
+		bucketCount = newBucketCount;
+		bucketMask = newBucketCount - 1;
+
+		DLOG("Allocated transposition table with " << bucketCount << " buckets (" << (bucketCount * sizeof(TransposBucket) / TRANSPOS_BYTES_PER_MB) << "MB)");
 	}
 
-#ifdef _DEBUG
-	LOG(" > Decreased: " << numDecreased);
-	LOG(" > Reset: " << numReset);
-#endif
+	Reset();
+}
+
+void TransposTable::Reset() {
+	for (size_t i = 0; i < bucketCount; i++)
+		new (&buckets[i]) TransposBucket();
+
+	generation = 0;
 }
 
 TransposTable
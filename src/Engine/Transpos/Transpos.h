@@ -2,39 +2,120 @@
 #include "../PieceValue/PieceValue.h"
 #include "../Zobrist/Zobrist.h"
 
-struct TransposEntry {
-	ZobristHash fullHash;
-	Value eval;
-	uint16_t depth;
+// Number of bits used to store the generation of an entry
+#define TRANSPOS_GENERATION_BITS 6
+#define TRANSPOS_GENERATION_MASK ((1 << TRANSPOS_GENERATION_BITS) - 1)
+
+// When picking an entry to replace, each search of age counts as this many plies of depth
+#define TRANSPOS_AGE_DEPTH_PENALTY 4
+
+// Is the stored eval an exact eval, or just a bound of the true eval?
+enum {
+	TRANSPOS_BOUND_EXACT,
+	TRANSPOS_BOUND_LOWER, // True eval is >= stored eval (we failed high)
+	TRANSPOS_BOUND_UPPER, // True eval is <= stored eval (we failed low)
+};
+
+// Unpacked contents of a transposition entry
+struct TransposData {
+	int32_t eval;
+
+	// Best move, packed (see Move::Pack())
+	uint16_t bestMove;
+
+	uint8_t depth;
+	uint8_t bound;
+	uint8_t generation;
+
+	// Bit layout of a packed data word:
+	//	[0, 32): eval
+	//	[32, 48): best move
+	//	[48, 56): depth
+	//	[56, 58): bound
+	//	[58, 64): generation
+	FINLINE uint64_t Pack() const {
+		return
+			(uint64_t)(uint32_t)eval |
+			((uint64_t)bestMove << 32) |
+			((uint64_t)depth << 48) |
+			((uint64_t)(bound & 3) << 56) |
+			((uint64_t)(generation & TRANSPOS_GENERATION_MASK) << 58);
+	}
 
-	// True index of the best move (see Move.trueIndex)
-	uint16_t bestMoveTrueIndex;
+	FINLINE static TransposData Unpack(uint64_t data) {
+		TransposData result;
+		result.eval = (int32_t)(uint32_t)data;
+		result.bestMove = (uint16_t)(data >> 32);
+		result.depth = (uint8_t)(data >> 48);
+		result.bound = (data >> 56) & 3;
+		result.generation = (uint8_t)(data >> 58);
+		return result;
+	}
+};
+
+// A single 16-byte entry, safe to read and write from any number of threads without locking
+// The hash is stored XOR'd with the data, so a torn entry (data from one write, hash from another)
+//	will simply fail to match instead of returning corrupted data
+struct TransposEntry {
+	std::atomic<uint64_t> hashXorData, data;
 
-	// We are currently exploring a position "within" this position, aka this position is a parent node of our current search
-	bool within = false;
+	TransposEntry() : hashXorData(0), data(0) {}
 
-	// TODO: Store type for proper usage with alpha-beta pruning
-	// Is this an alpha eval, beta eval, or exact eval?
+	TransposEntry(const TransposEntry& other) {
+		hashXorData.store(other.hashXorData.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		data.store(other.data.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
 
-	TransposEntry() {
-		// I would allow fullHash to be uninitialized, but there's a risk that the memory could have been previously another hash.
-		// To fix this, I could zero transposition table memory whenever resized, but what if another engine's memory is used or something?
-		fullHash = NULL;
+	TransposEntry& operator=(const TransposEntry& other) {
+		hashXorData.store(other.hashXorData.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		data.store(other.data.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
 	}
 
+	// NOTE: Data that packs to zero (a depth 0 draw with no best move, from generation 0) is treated as empty,
+	//	which only loses a quiescence search result
 	FINLINE bool IsValid() const {
-		return fullHash != NULL;
+		return data.load(std::memory_order_relaxed) != 0;
 	}
 
 	FINLINE void Reset() {
-		fullHash = NULL;
+		hashXorData.store(0, std::memory_order_relaxed);
+		data.store(0, std::memory_order_relaxed);
+	}
+
+	// Returns false if this entry isn't for this hash
+	FINLINE bool Load(ZobristHash hash, TransposData& dataOut) const {
+		uint64_t curData = data.load(std::memory_order_relaxed);
+		uint64_t curHashXorData = hashXorData.load(std::memory_order_relaxed);
+		if ((curHashXorData ^ curData) != hash || !curData)
+			return false;
+
+		dataOut = TransposData::Unpack(curData);
+		return true;
+	}
+
+	FINLINE void Store(ZobristHash hash, const TransposData& newData) {
+		uint64_t packedData = newData.Pack();
+		data.store(packedData, std::memory_order_relaxed);
+		hashXorData.store(hash ^ packedData, std::memory_order_relaxed);
+	}
+
+	// How desirable it is to keep whatever is in this entry, without verifying the hash
+	// Deeper entries are more valuable, entries from older searches are less valuable
+	FINLINE int GetKeepValue(uint8_t curGeneration) const {
+		TransposData curData = TransposData::Unpack(data.load(std::memory_order_relaxed));
+		int age = (curGeneration - curData.generation) & TRANSPOS_GENERATION_MASK;
+		return curData.depth - (age * TRANSPOS_AGE_DEPTH_PENALTY);
 	}
 };
 
+SASSERT(sizeof(TransposEntry) == 16, "TransposEntry must be packed into 16 bytes");
+
 // Amount of entries per bucket
 #define TRANSPOS_BUCKET_SIZE 4
 
-struct TransposBucket {
+// NOTE: Aligned so that a whole bucket always sits in one cache line
+struct alignas(64) TransposBucket {
 	TransposEntry entries[TRANSPOS_BUCKET_SIZE];
 
 	FINLINE TransposEntry& operator[](size_t index) {
@@ -43,34 +124,45 @@ struct TransposBucket {
 	}
 };
 
-// Number of buckets for every megabyte of memory
-#define TRANSPOS_BUCKET_COUNT_MB (1000 * 1000 / sizeof(TransposBucket))
+SASSERT(sizeof(TransposBucket) == 64, "TransposBucket must fit exactly in one cache line");
+
+#define TRANSPOS_BYTES_PER_MB (1024 * 1024)
 
-// Decrease in depth for old buckets from a pervious search
-#define TRANSPOS_OLD_DEPTH_DECREASE 3
+// Default size of the table, in megabytes
+#define TRANSPOS_DEFAULT_SIZE_MB 64
+#define TRANSPOS_MAX_SIZE_MB (1024 * 1024)
 
-// TODO: Multithreading support (just give each thread its own portion of the buckets)
+// NOTE: Shared by all search threads, entries are lockless (see TransposEntry)
 struct TransposTable {
-	vector<TransposBucket> buckets;
-	
-	TransposTable() {
-		buckets = {};
-	}
+	TransposBucket* buckets = NULL;
+
+	// NOTE: Always a power of two
+	size_t bucketCount = 0;
 
-	void Init(size_t bucketCount);
+	// (bucketCount - 1), used to get a bucket index from a hash
+	size_t bucketMask = 0;
+
+	// Incremented every search, entries store the generation they were written in
+	// NOTE: Wraps around after TRANSPOS_GENERATION_MASK
+	uint8_t generation = 0;
+
+	TransposTable() = default;
+
+	// (Re)allocates the table to the largest power-of-two bucket count that fits within sizeMB, and clears it
+	// NOTE: Must not be called during a search
+	void Init(size_t sizeMB);
 	void Reset();
 
 	FINLINE TransposEntry* Find(ZobristHash hash) {
-		// TODO: Maybe force bucketCount to a power of two and store the number of bits
-		//	That way, we can bit shift instead of expensive modulo on two runtime values
-		size_t bucketIndex = hash % buckets.size();
+		size_t bucketIndex = hash & bucketMask;
 
 		TransposBucket& bucket = buckets[bucketIndex];
 
 		// Try to find matching entry
+		TransposData unusedData;
 		for (size_t i = 0; i < TRANSPOS_BUCKET_SIZE; i++) {
 			TransposEntry& entry = bucket[i];
-			if (entry.fullHash == hash)
+			if (entry.Load(hash, unusedData))
 				return &entry;
 		}
 
@@ -78,14 +170,15 @@ struct TransposTable {
 		// Try to find entry to replace
 		// TODO: Maybe merge this with the first loop for efficiency (??)
 		size_t toReplaceIndex = 0;
-		uint16_t lowestDepth = bucket[0].depth;
-		for (size_t i = 1; i < TRANSPOS_BUCKET_SIZE; i++) {
+		int lowestKeepValue = INT32_MAX;
+		for (size_t i = 0; i < TRANSPOS_BUCKET_SIZE; i++) {
 			TransposEntry& entry = bucket[i];
 			if (!entry.IsValid())
 				return &entry; // Found empty, use it
 
-			if (entry.depth < lowestDepth) {
-				lowestDepth = entry.depth;
+			int keepValue = entry.GetKeepValue(generation);
+			if (keepValue < lowestKeepValue) {
+				lowestKeepValue = keepValue;
 				toReplaceIndex = i;
 			}
 		}
@@ -93,9 +186,35 @@ struct TransposTable {
 		return &(bucket[toReplaceIndex]);
 	}
 
-	void MarkOld();
+	// Call at the start of every search, ages all existing entries without touching them
+	FINLINE void NewSearch() {
+		generation = (generation + 1) & TRANSPOS_GENERATION_MASK;
+	}
 };
 
 namespace Transpos {
 	extern TransposTable main;
-}
\ No newline at end of file
+
+	// Checkmate values depend on how many plies from the root the checkmate is (see GetCheckmatedValue() in Engine.cpp),
+	//	but the same entry can be found from any ply, so entries count those plies from their own position instead
+	FINLINE int32_t ValueToEntry(Value eval, uint16_t ply) {
+		if (eval >= CHECKMATE_VALUE) {
+			return (int32_t)(eval + ply);
+		} else if (eval <= -CHECKMATE_VALUE) {
+			return (int32_t)(eval - ply);
+		} else {
+			return (int32_t)eval;
+		}
+	}
+
+	// Reverses ValueToEntry() for the ply we found the entry at
+	FINLINE Value ValueFromEntry(int32_t eval, uint16_t ply) {
+		if (eval >= CHECKMATE_VALUE) {
+			return eval - ply;
+		} else if (eval <= -CHECKMATE_VALUE) {
+			return eval + ply;
+		} else {
+			return eval;
+		}
+	}
+}
@@ -133,7 +133,7 @@ void FEN::Parse(vector<string> tokens, BoardState& boardStateOut) {
 			if (enPassantToPos >= BD_SQUARE_AMOUNT)
 				THROW("Out-of-bounds en passant coordinate: \"" << enPassantToken << "\"");
 
-			boardStateOut.enPassantToMask.Set(enPassantToPos, true);
+			boardStateOut.enPassantToPos = enPassantToPos;
 
 			Pos enPassantCapturePos = Pos(enPassantToPos.X(), enPassantToPos.Y() + (boardStateOut.turnTeam ? 1 : -1));
 			boardStateOut.enPassantPawnPos = enPassantCapturePos;
@@ -8,6 +8,7 @@
 #define _USE_MATH_DEFINES
 
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <chrono>
@@ -19,6 +20,7 @@
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <random>
@@ -3,14 +3,20 @@
 #include "../FEN/FEN.h"
 #include "../Engine/Engine.h"
 #include "../Engine/MoveGen/MoveGen.h"
+#include "../Engine/Transpos/Transpos.h"
+#include "../Engine/PerftCache/PerftCache.h"
+#include "../Engine/NNUE/NNUE.h"
 
 std::condition_variable engineUpdateConVar;
 std::mutex engineUpdateWaitMutex;
 
 struct {
 	bool isPerft = false;
+	bool isPonder = false;
 	uint16_t depth = MAX_SEARCH_DEPTH;
-	size_t maxTimeMS = -1;
+	TimeControl timeControl;
+	uint64_t maxNodes = 0;
+	vector<Move> searchMoves;
 } searchParams;
 
 std::thread engineThread;
@@ -23,24 +29,37 @@ void EngineSearchLoop() {
 		if (searchParams.isPerft) {
 			Engine::DoPerftSearch(searchParams.depth);
 		} else {
-			uint8_t searchResult = Engine::DoSearch(searchParams.depth, searchParams.maxTimeMS);
+			uint8_t searchResult = Engine::DoSearch(
+				searchParams.depth, searchParams.timeControl, searchParams.isPonder,
+				searchParams.maxNodes, searchParams.searchMoves
+			);
 			if (searchResult != Engine::SEARCH_COULDNT_START) {
 				vector<Move> moves = Engine::GetCurrentPV();
 				if (moves.empty()) {
 					assert(false);
 					LOG("bestmove none");
 				} else {
-					LOG("bestmove " << moves.front());
+					if (moves.size() > 1) {
+						// Suggest the reply we expect, so the GUI can have us ponder on it
+						LOG("bestmove " << moves[0] << " ponder " << moves[1]);
+					} else {
+						LOG("bestmove " << moves.front());
+					}
 				}
 			}
 		}
 	}
 }
 
-void StartEngine(bool isPerft, uint16_t depth, size_t maxTimeMS) {
+void StartEngine(
+	bool isPerft, uint16_t depth, const TimeControl& timeControl, bool isPonder = false,
+	uint64_t maxNodes = 0, const vector<Move>& searchMoves = {}) {
 	searchParams.isPerft = isPerft;
+	searchParams.isPonder = isPonder;
 	searchParams.depth = CLAMP(depth, 1, MAX_SEARCH_DEPTH);
-	searchParams.maxTimeMS = maxTimeMS = MAX(maxTimeMS, 0);
+	searchParams.timeControl = timeControl;
+	searchParams.maxNodes = maxNodes;
+	searchParams.searchMoves = searchMoves;
 	engineUpdateConVar.notify_one();
 }
 
@@ -52,6 +71,74 @@ void StopEngine() {
 		std::this_thread::yield();
 }
 
+// Returns false if the option doesn't exist or the value is invalid
+bool SetOption(string name, string value) {
+	Engine::Settings& settings = Engine::GetSettings();
+
+	int64_t intValue;
+	try {
+		intValue = std::stoll(value);
+	} catch (std::exception& e) {
+		intValue = -1;
+	}
+
+	if (name == "Threads") {
+		if (intValue < 1 || intValue > MAX_SEARCH_THREADS)
+			return false;
+
+		settings.threadCount = intValue;
+		return true;
+	} else if (name == "Hash") {
+		if (intValue < 1 || intValue > TRANSPOS_MAX_SIZE_MB)
+			return false;
+
+		Transpos::main.Init(intValue);
+		return true;
+	} else if (name == "PerftHash") {
+		if (intValue < 0 || intValue > PERFT_CACHE_MAX_SIZE_MB)
+			return false;
+
+		PerftCache::main.Init(intValue);
+		return true;
+	} else if (name == "MultiPV") {
+		if (intValue < 1 || intValue > MAX_MULTI_PV)
+			return false;
+
+		settings.multiPV = intValue;
+		return true;
+	} else if (name == "EvalFile") {
+		if (value.empty() || value == "<empty>") {
+			NNUE::Unload();
+			return true;
+		}
+
+		if (!NNUE::LoadFile(value)) {
+			LOG("info string Failed to load NNUE network from \"" << value << "\"");
+			return false;
+		}
+
+		LOG("info string Loaded NNUE network from \"" << value << "\"");
+		return true;
+	} else if (name == "UseNNUE") {
+		if (value != "true" && value != "false")
+			return false;
+
+		settings.useNNUE = (value == "true");
+		return true;
+	} else if (name == "Ponder") {
+		// Only tells us that the GUI may send "go ponder", nothing to change
+		return value == "true" || value == "false";
+	} else if (name == "QSearchChecks") {
+		if (value != "true" && value != "false")
+			return false;
+
+		settings.quiescenceChecks = (value == "true");
+		return true;
+	}
+
+	return false;
+}
+
 void UCI::Init() {
 	engineThread = std::thread(EngineSearchLoop);
 	DLOG("Starting engine search loop on thread " << engineThread.get_id() << "...");
@@ -64,6 +151,14 @@ bool UCI::ProcessCommand(vector<string> parts) {
 	if (firstPart == "uci") {
 		LOG("id name BoardMouse " BM_VERSION)
 		LOG("id author ZealanL")
+		LOG("option name Hash type spin default " << TRANSPOS_DEFAULT_SIZE_MB << " min 1 max " << TRANSPOS_MAX_SIZE_MB);
+		LOG("option name PerftHash type spin default " << PERFT_CACHE_DEFAULT_SIZE_MB << " min 0 max " << PERFT_CACHE_MAX_SIZE_MB);
+		LOG("option name Threads type spin default 1 min 1 max " << MAX_SEARCH_THREADS);
+		LOG("option name MultiPV type spin default 1 min 1 max " << MAX_MULTI_PV);
+		LOG("option name Ponder type check default false");
+		LOG("option name EvalFile type string default <empty>");
+		LOG("option name UseNNUE type check default " << (Engine::Settings().useNNUE ? "true" : "false"));
+		LOG("option name QSearchChecks type check default " << (Engine::Settings().quiescenceChecks ? "true" : "false"));
 		LOG("uciok");
 		return true;
 	} else if (firstPart == "isready") {
@@ -106,15 +201,18 @@ bool UCI::ProcessCommand(vector<string> parts) {
 			return false;
 		}
 
+		vector<ZobristHash> history;
 		if (nextIndex < parts.size() && parts[nextIndex] == "moves") {
 			for (int i = nextIndex + 1; i < parts.size(); i++) {
 				string moveStr = parts[i];
 				MoveList legalMoves;
+				newPosition.UpdateIfNeeded(!newPosition.turnTeam);
 				MoveGen::GetMoves(newPosition, legalMoves);
 
 				bool moveFound = false;
 				for (auto& move : legalMoves) {
 					if (STR(move) == moveStr) {
+						history.push_back(newPosition.hash);
 						newPosition.ExecuteMove(move);
 						moveFound = true;
 					}
@@ -125,19 +223,41 @@ bool UCI::ProcessCommand(vector<string> parts) {
 			}
 		}
 
-		Engine::SetPosition(newPosition);
+		Engine::SetPosition(newPosition, history);
 		return true;
 	} else if (firstPart == "go") {
 
 		uint16_t depth = MAX_SEARCH_DEPTH;
-		size_t maxTimeMS = -1;
+		TimeControl timeControl;
 
 		std::unordered_map<string, int64_t> argMap;
 
+		// Moves after "searchmoves", these look like arguments so they need parsing separately
+		vector<Move> searchMoves;
+
 		for (int i = 1; i < parts.size(); i++) {
 			string part = parts[i];
-			if (isalpha(part.front())) {
-				if (i < parts.size() - 1 && isdigit(parts[i + 1].front())) {
+			if (part == "searchmoves") {
+				MoveList legalMoves;
+				MoveGen::GetMoves(Engine::GetPosition(), legalMoves);
+
+				// Take every following part that is a legal move
+				for (; i < parts.size() - 1; i++) {
+					bool moveFound = false;
+					for (auto& move : legalMoves) {
+						if (STR(move) == parts[i + 1]) {
+							searchMoves.push_back(move);
+							moveFound = true;
+							break;
+						}
+					}
+
+					if (!moveFound)
+						break;
+				}
+			} else if (isalpha(part.front())) {
+				string nextPart = (i < parts.size() - 1) ? parts[i + 1] : "";
+				if (!nextPart.empty() && (isdigit(nextPart.front()) || (nextPart.front() == '-' && nextPart.size() > 1))) {
 					int64_t val;
 					try {
 						val = std::stoll(parts[i + 1]);
@@ -151,12 +271,28 @@ bool UCI::ProcessCommand(vector<string> parts) {
 			}
 		}
 
-		bool isPerft = false;
+		bool isPerft = false, isPonder = false;
+		uint64_t maxNodes = 0;
 		for (const pair<string, int64_t>& arg : argMap) {
 			if (arg.first == "depth") {
 				depth = arg.second;
 			} else if (arg.first == "movetime") {
-				maxTimeMS = arg.second;
+				timeControl.moveTime = arg.second;
+			} else if (arg.first == "wtime") {
+				timeControl.timeLeft[TEAM_WHITE] = MAX(arg.second, 0); // Clocks can go negative when we're out of time
+			} else if (arg.first == "btime") {
+				timeControl.timeLeft[TEAM_BLACK] = MAX(arg.second, 0);
+			} else if (arg.first == "winc") {
+				timeControl.increment[TEAM_WHITE] = arg.second;
+			} else if (arg.first == "binc") {
+				timeControl.increment[TEAM_BLACK] = arg.second;
+			} else if (arg.first == "movestogo") {
+				timeControl.movesToGo = arg.second;
+			} else if (arg.first == "nodes") {
+				if (arg.second > 0)
+					maxNodes = arg.second;
+			} else if (arg.first == "ponder") {
+				isPonder = true;
 			} else if (arg.first == "perft") {
 				isPerft = true;
 				depth = arg.second;
@@ -167,13 +303,36 @@ bool UCI::ProcessCommand(vector<string> parts) {
 		// TODO: Support the variety of other arguments
 
 		StopEngine();
-		StartEngine(isPerft, depth, maxTimeMS);
+		StartEngine(isPerft, depth, timeControl, isPonder, maxNodes, searchMoves);
 		return true;
 
+	} else if (firstPart == "setoption") {
+		// Format: setoption name <id> [value <x>]
+		// NOTE: Names and values may contain spaces
+		string name, value;
+		string* curToken = NULL;
+		for (int i = 1; i < parts.size(); i++) {
+			if (parts[i] == "name") {
+				curToken = &name;
+			} else if (parts[i] == "value") {
+				curToken = &value;
+			} else if (curToken) {
+				if (!curToken->empty())
+					*curToken += ' ';
+				*curToken += parts[i];
+			}
+		}
+
+		if (Engine::GetState() == Engine::STATE_SEARCHING)
+			return false; // Options can't be changed mid-search
+
+		return SetOption(name, value);
 	} else if (firstPart == "d") {
 		LOG(Engine::GetPosition());
 	} else if (firstPart == "stop") {
 		StopEngine();
+	} else if (firstPart == "ponderhit") {
+		Engine::PonderHit();
 	} else {
 		// TODO: Support more commands
 	}
@@ -1,6 +1,8 @@
 #include "UCI/UCI.h"
 #include "Engine/LookupGen/LookupGen.h"
 #include "Engine/Transpos/Transpos.h"
+#include "Engine/PerftCache/PerftCache.h"
+#include "Engine/NNUE/NNUE.h"
 #include "Engine/Engine.h"
 #include "FEN/FEN.h"
 
@@ -10,7 +12,10 @@ int main() {
 	LOG(" > Built on " __DATE__);
 
 	LookupGen::InitOnce();
-	Transpos::main.Init(TRANSPOS_BUCKET_COUNT_MB * 50);
+	Transpos::main.Init(TRANSPOS_DEFAULT_SIZE_MB);
+	PerftCache::main.Init(PERFT_CACHE_DEFAULT_SIZE_MB);
+	if (NNUE::LoadEmbedded())
+		LOG(" > Loaded embedded NNUE network");
 	Engine::SetState(Engine::STATE_READY);
 
 	// Initialize with starting position